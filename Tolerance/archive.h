@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "tolerance.h"
+#include "correctionfactor.h"
+
+// Archived measurements of many units, one units x pins matrix per tolerance
+// (same row-major layout as the strip evaluator).
+class CMeasurementArchive
+{
+public:
+	struct ArchiveColumn
+	{
+		CToleranceBase* pTol;
+		size_t nPins;
+		std::vector<double> vNominals;		// empty for absolute values
+		std::vector<double> vValues;		// units x pins
+		const CCalibrationTable* pCalibration;
+
+		const double* GetNominals() const
+		{
+			return vNominals.empty() ? nullptr : vNominals.data();
+		}
+	};
+
+	CMeasurementArchive() :
+		m_nUnits(0),
+		m_nHeads(1)
+	{ }
+
+	// columns must be added before the first unit; nPins is 1 for tolerances without per-pin values.
+	// Values are archived raw, the calibration table is applied whenever they are checked.
+	void AddTolerance(CToleranceBase* pTol, size_t nPins, std::vector<double> vNominals = std::vector<double>(),
+		const CCalibrationTable* pCalibration = nullptr)
+	{
+		ArchiveColumn column = { pTol, nPins, std::move(vNominals), std::vector<double>(), pCalibration };
+		m_Columns.emplace_back(std::move(column));
+	}
+
+	// vValues[i] points to the nPins values of the i-th added tolerance; heads are numbered from 0
+	void AddUnit(const std::vector<const double*>& vValues, int nHead = 0)
+	{
+		if (nHead < 0)
+			throw std::invalid_argument("CMeasurementArchive: negative head");
+
+		m_Heads.emplace_back(nHead);
+		m_nHeads = std::max(m_nHeads, static_cast<size_t>(nHead) + 1);
+		for (size_t nColumn = 0; nColumn < m_Columns.size(); ++nColumn)
+		{
+			auto& column = m_Columns[nColumn];
+			column.vValues.insert(column.vValues.end(), vValues[nColumn], vValues[nColumn] + column.nPins);
+		}
+		++m_nUnits;
+	}
+
+	size_t GetUnitCount() const
+	{
+		return m_nUnits;
+	}
+
+	size_t GetColumnCount() const
+	{
+		return m_Columns.size();
+	}
+
+	const ArchiveColumn& GetColumn(size_t nColumn) const
+	{
+		return m_Columns[nColumn];
+	}
+
+	// optical head of each unit
+	const std::vector<int>& GetHeads() const
+	{
+		return m_Heads;
+	}
+
+	// heads 0 .. highest archived head; calibration tables are expanded for this many
+	size_t GetHeadCount() const
+	{
+		return m_nHeads;
+	}
+
+private:
+	std::vector<ArchiveColumn> m_Columns;
+	std::vector<int> m_Heads;
+	size_t m_nUnits;
+	size_t m_nHeads;
+};
\ No newline at end of file
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "tolerance.h"
+#include "result.h"
+#include "correctionfactor.h"
+
+// one measured ball (or pad) of a unit
+struct BallRecord
+{
+	double m_dHeight;
+	double m_dPitch;
+	double m_dQuality;
+	double m_dPadSize;
+};
+
+// Fused per-pin evaluation
+// Every enabled per-pin tolerance of a recipe is bound to one BallRecord field and all
+// of them are checked in a single sweep: the balls are streamed once in blocks of 64,
+// and each tolerance walks the block while it is still in L1. The result is one fail
+// mask per tolerance and an "any fail" mask, one bit per pin.
+class CBallChecker
+{
+public:
+	// calibration tables are expanded for heads 0 .. nHeads - 1
+	CBallChecker(const CPriorityRanking& ranking, size_t nPins, size_t nHeads = 1) :
+		m_Ranking(ranking),
+		m_nPins(nPins),
+		m_nHeads(nHeads),
+		m_nWords((nPins + 63) / 64),
+		m_bFrozen(false),
+		m_nFailRanks(0)
+	{ }
+
+	// only per-pin tolerances can be bound; nominals (nPins values) make the check relative.
+	// The calibration table, if any, is expanded at Freeze and must outlive it.
+	void AddTolerance(CToleranceBase* pTol, double BallRecord::* pField,
+		const double* pNominals = nullptr, const CCalibrationTable* pCalibration = nullptr)
+	{
+		if (!pTol->HasPerPin())
+			throw std::invalid_argument("CBallChecker: " + pTol->GetName() + " has no per-pin values");
+
+		BallBinding binding;
+		binding.pTol = pTol;
+		binding.pField = pField;
+		binding.pNominals = pNominals;
+		binding.pCalibration = pCalibration;
+		binding.dRejectLo = 0.0;
+		binding.dRejectHi = 0.0;
+		binding.nRank = 0;
+		m_Bindings.emplace_back(std::move(binding));
+		m_bFrozen = false;
+	}
+
+	// snapshot limits of the enabled tolerances; call again whenever a limit or enable flag changes
+	void Freeze()
+	{
+		m_Enabled.clear();
+		for (size_t nBinding = 0; nBinding < m_Bindings.size(); ++nBinding)
+		{
+			auto& binding = m_Bindings[nBinding];
+			binding.vFailBits.assign(m_nWords, 0);
+			if (!CToleranceBase::enabled_tolerance(binding.pTol))
+				continue;
+
+			binding.pTol->GetRejectLimits(binding.dRejectLo, binding.dRejectHi);
+			binding.nRank = m_Ranking.GetRank(binding.pTol);
+
+			// uncalibrated tolerances get one identity row, so every check is value * multiplier + offset
+			if (binding.pCalibration)
+				binding.pCalibration->Expand(m_nHeads, m_nPins, binding.pNominals, binding.vMultipliers, binding.vOffsets);
+			else
+				CCalibrationTable().Expand(1, m_nPins, binding.pNominals, binding.vMultipliers, binding.vOffsets);
+
+			m_Enabled.emplace_back(nBinding);
+		}
+		m_AnyFail.assign(m_nWords, 0);
+		m_bFrozen = true;
+	}
+
+	// check the nPins balls of one unit measured by optical head nHead
+	void Evaluate(const BallRecord* pBalls, int nHead = 0)
+	{
+		if (!m_bFrozen)
+			throw std::logic_error("CBallChecker: Evaluate before Freeze");
+		if (nHead < 0 || static_cast<size_t>(nHead) >= m_nHeads)
+			throw std::out_of_range("CBallChecker: head out of range");
+
+		std::fill(m_AnyFail.begin(), m_AnyFail.end(), 0ULL);
+		m_nFailRanks = 0;
+
+		for (size_t nWord = 0; nWord < m_nWords; ++nWord)
+		{
+			const size_t nBegin = nWord * 64;
+			const size_t nCount = std::min<size_t>(64, m_nPins - nBegin);
+			const BallRecord* pBlock = pBalls + nBegin;
+
+			unsigned long long anyFail = 0;
+			for (auto itr = m_Enabled.begin(); itr != m_Enabled.end(); ++itr)
+			{
+				auto& binding = m_Bindings[*itr];
+				const size_t nRow = binding.pCalibration ? static_cast<size_t>(nHead) * m_nPins : 0;
+				const double* pMul = binding.vMultipliers.data() + nRow + nBegin;
+				const double* pOff = binding.vOffsets.data() + nRow + nBegin;
+				const double dRejectLo = binding.dRejectLo;
+				const double dRejectHi = binding.dRejectHi;
+				const double BallRecord::* pField = binding.pField;
+
+				unsigned long long failBits = 0;
+				for (size_t i = 0; i < nCount; ++i)
+				{
+					const double value = pBlock[i].*pField * pMul[i] + pOff[i];
+					failBits |= static_cast<unsigned long long>((value < dRejectLo) | (value > dRejectHi)) << i;
+				}
+
+				binding.vFailBits[nWord] = failBits;
+				anyFail |= failBits;
+				m_nFailRanks |= (1ULL << binding.nRank) & (0ULL - (failBits != 0));
+			}
+			m_AnyFail[nWord] = anyFail;
+		}
+	}
+
+	// one bit per pin, set when the pin failed the nBinding-th added tolerance (all clear while disabled)
+	const std::vector<unsigned long long>& GetFailBits(size_t nBinding) const
+	{
+		return m_Bindings[nBinding].vFailBits;
+	}
+
+	// one bit per pin, set when the pin failed any enabled tolerance
+	const std::vector<unsigned long long>& GetAnyFailBits() const
+	{
+		return m_AnyFail;
+	}
+
+	// bit i set when any pin failed the tolerance of rank i, as recorded by CModuleResult
+	unsigned long long GetFailRanks() const
+	{
+		return m_nFailRanks;
+	}
+
+	bool IsPinPass(size_t nPin) const
+	{
+		return (m_AnyFail[nPin / 64] >> (nPin % 64) & 1) == 0;
+	}
+
+private:
+	struct BallBinding
+	{
+		CToleranceBase* pTol;
+		double BallRecord::* pField;
+		const double* pNominals;
+		const CCalibrationTable* pCalibration;
+		double dRejectLo;
+		double dRejectHi;
+		size_t nRank;
+		std::vector<double> vMultipliers;		// heads x pins, or one identity row
+		std::vector<double> vOffsets;			// nominals folded in
+		std::vector<unsigned long long> vFailBits;
+	};
+
+	const CPriorityRanking& m_Ranking;
+	const size_t m_nPins;
+	const size_t m_nHeads;
+	const size_t m_nWords;
+
+	std::vector<BallBinding> m_Bindings;
+	std::vector<size_t> m_Enabled;
+	bool m_bFrozen;							// cleared by AddTolerance
+
+	std::vector<unsigned long long> m_AnyFail;
+	unsigned long long m_nFailRanks;
+};
\ No newline at end of file
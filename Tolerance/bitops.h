@@ -0,0 +1,35 @@
+#pragma once
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// index of the lowest set bit; value must not be 0
+inline unsigned int CountTrailingZeros(unsigned long long value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long nIndex;
+	_BitScanForward64(&nIndex, value);
+	return nIndex;
+#elif defined(_MSC_VER)
+	unsigned long nIndex;
+	if (_BitScanForward(&nIndex, static_cast<unsigned long>(value)))
+		return nIndex;
+	_BitScanForward(&nIndex, static_cast<unsigned long>(value >> 32));
+	return nIndex + 32;
+#else
+	return static_cast<unsigned int>(__builtin_ctzll(value));
+#endif
+}
+
+// number of set bits
+inline unsigned int PopCount(unsigned long long value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	return static_cast<unsigned int>(__popcnt64(value));
+#elif defined(_MSC_VER)
+	return __popcnt(static_cast<unsigned int>(value)) + __popcnt(static_cast<unsigned int>(value >> 32));
+#else
+	return static_cast<unsigned int>(__builtin_popcountll(value));
+#endif
+}
\ No newline at end of file
@@ -1,8 +1,78 @@
 #pragma once
 
+#include <map>
+#include <vector>
+#include <stdexcept>
+
 template<typename T>
 struct CorrectionFactor
 {
 	double m_multiplier;
 	T m_offset;
+};
+
+// Correction factors of one tolerance per optical head, optionally overridden per pin
+class CCalibrationTable
+{
+public:
+	// heads are numbered from 0
+	void SetHeadFactor(int nHead, CorrectionFactor<double> factor)
+	{
+		m_Heads[CheckHead(nHead)].m_Factor = factor;
+	}
+
+	void SetPinFactor(int nHead, size_t nPin, CorrectionFactor<double> factor)
+	{
+		m_Heads[CheckHead(nHead)].m_PinFactors[nPin] = factor;
+	}
+
+	// Expand at recipe freeze into nHeads x nPins multipliers and offsets. Heads without
+	// factors get an identity row and factors of heads >= nHeads are unused. Nominals,
+	// when given, are folded into the offsets, so a relative value is a single
+	// multiply-add: value * multiplier + (offset - nominal).
+	void Expand(size_t nHeads, size_t nPins, const double* pNominals, std::vector<double>& vMultipliers, std::vector<double>& vOffsets) const
+	{
+		vMultipliers.assign(nHeads * nPins, 1.0);
+		vOffsets.assign(nHeads * nPins, 0.0);
+
+		for (auto itr = m_Heads.begin(); itr != m_Heads.end() && static_cast<size_t>(itr->first) < nHeads; ++itr)
+		{
+			const size_t nRow = static_cast<size_t>(itr->first) * nPins;
+			for (size_t nPin = 0; nPin < nPins; ++nPin)
+			{
+				auto pin = itr->second.m_PinFactors.find(nPin);
+				const auto& factor = pin != itr->second.m_PinFactors.end() ? pin->second : itr->second.m_Factor;
+				vMultipliers[nRow + nPin] = factor.m_multiplier;
+				vOffsets[nRow + nPin] = factor.m_offset;
+			}
+		}
+
+		if (pNominals)
+		{
+			for (size_t i = 0; i < vOffsets.size(); ++i)
+				vOffsets[i] -= pNominals[i % nPins];
+		}
+	}
+
+private:
+	struct HeadFactors
+	{
+		HeadFactors()
+		{
+			m_Factor.m_multiplier = 1.0;
+			m_Factor.m_offset = 0.0;
+		}
+
+		CorrectionFactor<double> m_Factor;
+		std::map<size_t, CorrectionFactor<double>> m_PinFactors;
+	};
+
+	static int CheckHead(int nHead)
+	{
+		if (nHead < 0)
+			throw std::invalid_argument("CCalibrationTable: negative head");
+		return nHead;
+	}
+
+	std::map<int, HeadFactors> m_Heads;
 };
\ No newline at end of file
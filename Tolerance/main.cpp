@@ -13,8 +13,16 @@
 #include <tuple>
 #include <iostream>
 #include <iomanip>
+#include <atomic>
+#include <thread>
 #include "tolerance.h"
 #include "result.h"
+#include "stripeval.h"
+#include "reeval.h"
+#include "sweep.h"
+#include "resultsink.h"
+#include "warpage.h"
+#include "ballcheck.h"
 
 using namespace std;
 
@@ -209,18 +217,27 @@ void TestRelativeMode()
 
 void TestFailResult()
 {
-	CModuleResult moduleResult(g_resultIds);
+	vector<CToleranceBase*> tolerances;
 
 	CToleranceMinMax tol1("Pad Size", "", 80.0, 100.0);
 	tol1.SetPriority(2);
-	moduleResult.AddFailResult(&tol1, "Pad Size: 40 (80.0, 100), Fail");
+	tolerances.push_back(&tol1);
 
 	CToleranceMin tol2("Ball Quality", "", 90.0);
 	tol2.SetPriority(0);
-	moduleResult.AddFailResult(&tol2, "Ball Quality: 40 < 90.0, Fail");
+	tolerances.push_back(&tol2);
 
 	CToleranceMinMax tol3("Ball Pitch", "", 80.0, 100.0);
 	tol3.SetPriority(1);
+	tolerances.push_back(&tol3);
+
+	// results may be created before the recipe is frozen
+	CPriorityRanking ranking;
+	CModuleResult moduleResult(g_resultIds, ranking);
+	ranking.Freeze(tolerances, g_resultIds);
+
+	moduleResult.AddFailResult(&tol1, "Pad Size: 40 (80.0, 100), Fail");
+	moduleResult.AddFailResult(&tol2, "Ball Quality: 40 < 90.0, Fail");
 	moduleResult.AddFailResult(&tol3, "Ball Pitch: 101 (80.0, 100), Fail");
 
 	cout << "\nTestFailResult\n";
@@ -283,6 +300,649 @@ void TestHasPerPin()
 	}
 }
 
+void TestStripEvaluation()
+{
+	CToleranceMinMaxT<double, TolPerPinTraits> tol1("Ball Height", "", -5.0, 5.0);
+	tol1.SetEnabled(true);
+	tol1.SetPriority(1);
+
+	CToleranceMaxT<double, Tol3DTraits> tol2("Warpage", "", 50.0);
+	tol2.SetEnabled(true);
+	tol2.SetPriority(0);
+
+	CToleranceMinMaxT<double, Tol2DPerPinTraits> tol3("Ball Pitch", "", 80.0, 100.0);
+	tol3.SetPriority(2);		// disabled
+
+	// 4 units x 3 pins, checked relative to per-pin nominals
+	const double heightNominals[] = { 100.0, 110.0, 120.0 };
+	const double heights[] =
+	{
+		101.0, 112.0, 119.0,
+		100.0, 116.0, 120.0,	// pin 1 out of range
+		 94.0, 110.0, 120.0,	// pin 0 out of range
+		100.0, 110.0, 120.0
+	};
+	const double warpages[] = { 10.0, 20.0, 60.0, 70.0 };
+	const double pitches[] = { 0.0, 0.0, 0.0, 0.0 };
+
+	vector<CToleranceBase*> tolerances;
+	tolerances.push_back(&tol1);
+	tolerances.push_back(&tol2);
+	tolerances.push_back(&tol3);
+
+	CPriorityRanking ranking;
+	ranking.Freeze(tolerances, g_resultIds);
+
+	CStripEvaluator evaluator(ranking);
+	evaluator.AddTolerance(&tol1, 3, heightNominals);
+	evaluator.AddTolerance(&tol2, 1);
+	evaluator.AddTolerance(&tol3, 1);
+	evaluator.Freeze();
+
+	vector<const double*> measurements;
+	measurements.push_back(heights);
+	measurements.push_back(warpages);
+	measurements.push_back(pitches);
+	evaluator.Evaluate(measurements, 4);
+
+	assert(evaluator.IsUnitPass(0));
+	assert(evaluator.GetFirstFailResultId(1) == INSP_FAIL_BALL_HEIGHT);
+	assert(evaluator.GetFirstFailResultId(2) == INSP_FAIL_WARPAGE);		// higher priority than Ball Height
+	assert(evaluator.GetFailMask(2) == 3);
+	assert(evaluator.GetFirstFailResultId(3) == INSP_FAIL_WARPAGE);
+
+	// the module result carries the reject limits of the first failure
+	CModuleResult moduleResult(g_resultIds, ranking);
+	evaluator.FillModuleResult(1, moduleResult);
+	assert(get<2>(moduleResult.GetFirstFailResult()) == "Ball Height: (-5, 5), Fail");
+	evaluator.FillModuleResult(2, moduleResult);
+	assert(get<2>(moduleResult.GetFirstFailResult()) == "Warpage: > 50, Fail");
+
+	// a matrix per tolerance, and no evaluation with tolerances added since the last Freeze
+	bool bThrown = false;
+	try
+	{
+		evaluator.Evaluate(vector<const double*>(1, heights), 4);
+	}
+	catch (const invalid_argument&)
+	{
+		bThrown = true;
+	}
+	assert(bThrown);
+
+	CStripEvaluator unfrozen(ranking);
+	unfrozen.AddTolerance(&tol1, 3, heightNominals);
+	bThrown = false;
+	try
+	{
+		unfrozen.Evaluate(vector<const double*>(1, heights), 4);
+	}
+	catch (const logic_error&)
+	{
+		bThrown = true;
+	}
+	assert(bThrown);
+	(void)bThrown;
+
+	// heads are not checked without calibration
+	const int heads[] = { 0, 1, 2, 3 };
+	evaluator.Evaluate(measurements, 4, heads);
+	assert(evaluator.GetFailMask(2) == 3);
+
+	cout << "\nTestStripEvaluation\n";
+	for (size_t nUnit = 0; nUnit < evaluator.GetUnitCount(); ++nUnit)
+	{
+		evaluator.FillModuleResult(nUnit, moduleResult);
+		auto resultIds = moduleResult.GetFailResultIds();
+		cout << left << setw(20) << "Unit " + to_string(nUnit) << ": " << evaluator.GetFirstFailResultId(nUnit) << ", fails=" << resultIds.size() << endl;
+	}
+}
+
+void TestReevaluation()
+{
+	CToleranceMinMaxT<double, TolPerPinTraits> tol1("Ball Height", "", 90.0, 110.0);
+	tol1.SetEnabled(true);
+	tol1.SetPriority(1);
+
+	CToleranceMaxT<double, Tol3DTraits> tol2("Warpage", "", 50.0);
+	tol2.SetEnabled(true);
+	tol2.SetPriority(0);
+
+	vector<CToleranceBase*> tolerances;
+	tolerances.push_back(&tol1);
+	tolerances.push_back(&tol2);
+
+	CPriorityRanking ranking;
+	ranking.Freeze(tolerances, g_resultIds);
+
+	// 200 units x 2 pins; height steps by 0.25 per unit, warpage cycles 0..99
+	CMeasurementArchive archive;
+	archive.AddTolerance(&tol1, 2);
+	archive.AddTolerance(&tol2, 1);
+	for (size_t nUnit = 0; nUnit < 200; ++nUnit)
+	{
+		const double heights[] = { 80.0 + nUnit * 0.25, 100.0 };
+		const double warpage = static_cast<double>(nUnit % 100);
+		vector<const double*> values;
+		values.push_back(heights);
+		values.push_back(&warpage);
+		archive.AddUnit(values);
+	}
+
+	CReevalCache cache(archive, ranking);
+	size_t nRecomputed = cache.Refresh();
+	assert(nRecomputed == 2);
+	nRecomputed = cache.Refresh();
+	assert(nRecomputed == 0);
+	assert(cache.GetPassCount() == 32);				// heights pass for units 40..120, warpage for 0..50 and 100..150
+	assert(cache.GetFirstFailResultId(10) == INSP_FAIL_BALL_HEIGHT);
+	assert(cache.GetFirstFailResultId(60) == INSP_FAIL_WARPAGE);
+	assert(cache.GetFirstFailResultId(130) == INSP_FAIL_BALL_HEIGHT);
+	assert(cache.GetFirstFailResultId(180) == INSP_FAIL_WARPAGE);
+
+	tol1.SetRejectUCL(120.0);
+	nRecomputed = cache.Refresh();
+	assert(nRecomputed == 1);						// only Ball Height is recomputed
+	assert(cache.GetPassCount() == 62);
+	assert(cache.IsUnitPass(130));
+
+	tol2.SetEnabled(false);
+	nRecomputed = cache.Refresh();
+	assert(nRecomputed == 0);
+	(void)nRecomputed;
+	assert(cache.GetPassCount() == 121);
+
+	// no verdicts before the first Refresh
+	CReevalCache unrefreshed(archive, ranking);
+	bool bThrown = false;
+	try
+	{
+		unrefreshed.IsUnitPass(0);
+	}
+	catch (const logic_error&)
+	{
+		bThrown = true;
+	}
+	assert(bThrown);
+	(void)bThrown;
+
+	cout << "\nTestReevaluation\n";
+	cout << left << setw(20) << "Pass Count" << ": " << cache.GetPassCount() << endl;
+}
+
+void TestLimitSweep()
+{
+	CToleranceMinMaxT<double, TolPerPinTraits> tol1("Ball Height", "", -4.0, 4.0);
+	tol1.SetEnabled(true);
+	tol1.SetPriority(0);
+
+	CToleranceMaxT<double, Tol3DTraits> tol2("Warpage", "", 80.0);
+	tol2.SetEnabled(true);
+	tol2.SetPriority(1);
+
+	vector<CToleranceBase*> tolerances;
+	tolerances.push_back(&tol1);
+	tolerances.push_back(&tol2);
+
+	CPriorityRanking ranking;
+	ranking.Freeze(tolerances, g_resultIds);
+
+	// 300 units x 3 pins of heights around per-pin nominals
+	const double nominals[] = { 100.0, 200.0, 300.0 };
+	CMeasurementArchive archive;
+	archive.AddTolerance(&tol1, 3, vector<double>(begin(nominals), end(nominals)));
+	archive.AddTolerance(&tol2, 1);
+	for (size_t nUnit = 0; nUnit < 300; ++nUnit)
+	{
+		const double heights[] = { 100.0 + (nUnit % 13) - 6.0, 200.0 - (nUnit % 7) * 0.5, 300.0 + (nUnit % 11) * 0.5 };
+		const double warpage = static_cast<double>(nUnit % 97);
+		vector<const double*> values;
+		values.push_back(heights);
+		values.push_back(&warpage);
+		archive.AddUnit(values);
+	}
+
+	CReevalCache cache(archive, ranking);
+	cache.Refresh();
+	const size_t nRefPass = cache.GetPassCount();
+
+	CLimitSweep sweep(archive, cache, 0);
+	assert(sweep.GetPassCount(-4.0, 4.0) == nRefPass);
+	(void)nRefPass;
+
+	// every answer must match a brute-force re-evaluation of the archive
+	const double limits[][2] = { { -6.0, 6.0 }, { -2.0, 5.0 }, { -3.0, 1.0 }, { 0.0, 0.0 }, { 2.0, -2.0 } };
+	for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); ++i)
+	{
+		tol1.SetRejectLCL(limits[i][0]);
+		tol1.SetRejectUCL(limits[i][1]);
+		cache.Refresh();
+		assert(sweep.GetPassCount(limits[i][0], limits[i][1]) == cache.GetPassCount());
+	}
+
+	vector<double> candidates;
+	for (int n = -7; n <= 1; ++n)
+		candidates.push_back(static_cast<double>(n));
+	auto curve = sweep.SweepRejectLo(candidates, 4.0);
+	for (auto itr = curve.begin(); itr != curve.end(); ++itr)
+	{
+		auto point = sweep.GetPoint(itr->dRejectLo, itr->dRejectHi);
+		assert(point.nPass == itr->nPass && point.nEscapes == itr->nEscapes && point.nOverkills == itr->nOverkills);
+		(void)point;
+	}
+
+	auto curveHi = sweep.SweepRejectHi(-4.0, candidates);
+	for (auto itr = curveHi.begin(); itr != curveHi.end(); ++itr)
+	{
+		auto point = sweep.GetPoint(itr->dRejectLo, itr->dRejectHi);
+		assert(point.nPass == itr->nPass && point.nEscapes == itr->nEscapes && point.nOverkills == itr->nOverkills);
+		(void)point;
+	}
+
+	// a sweep excluding units by stale limits of another tolerance is refused
+	tol2.SetRejectUCL(60.0);
+	bool bThrown = false;
+	try
+	{
+		CLimitSweep staleSweep(archive, cache, 0);
+	}
+	catch (const logic_error&)
+	{
+		bThrown = true;
+	}
+	assert(bThrown);
+	tol2.SetRejectUCL(80.0);
+
+	// as is a sweep over units the cache has not seen yet
+	const double heights[] = { 100.0, 200.0, 300.0 };
+	const double warpage = 0.0;
+	vector<const double*> values;
+	values.push_back(heights);
+	values.push_back(&warpage);
+	archive.AddUnit(values);
+
+	bThrown = false;
+	try
+	{
+		CLimitSweep staleSweep(archive, cache, 0);
+	}
+	catch (const logic_error&)
+	{
+		bThrown = true;
+	}
+	assert(bThrown);
+	(void)bThrown;
+
+	cout << "\nTestLimitSweep\n";
+	for (auto itr = curve.begin(); itr != curve.end(); ++itr)
+		cout << left << setw(20) << "Reject Lo " + to_string(static_cast<int>(itr->dRejectLo)) << ": " << 
+			"yield=" << setprecision(3) << itr->dYield << ", escapes=" << itr->nEscapes << ", overkills=" << itr->nOverkills << endl;
+}
+
+void TestResultSink()
+{
+	CToleranceMinMax tol1("Ball Height", "", 80.0, 100.0);
+	tol1.SetPriority(0);
+
+	CToleranceMax tol2("Warpage", "", 50.0);
+	tol2.SetPriority(1);
+
+	vector<CToleranceBase*> tolerances;
+	tolerances.push_back(&tol1);
+	tolerances.push_back(&tol2);
+
+	CPriorityRanking ranking;
+	ranking.Freeze(tolerances, g_resultIds);
+
+	const size_t nProducers = 2;
+	const size_t nUnitsPerProducer = 1000;
+
+	auto run = [&](CResultSink& sink) -> size_t
+	{
+		size_t nAccepted[nProducers] = { 0 };
+		vector<thread> producers;
+		for (size_t nProducer = 0; nProducer < nProducers; ++nProducer)
+		{
+			producers.emplace_back([&, nProducer]
+			{
+				for (size_t nUnit = 0; nUnit < nUnitsPerProducer; ++nUnit)
+				{
+					ResultRecord record = { nProducer * nUnitsPerProducer + nUnit, nUnit % 4, nUnit % 4 ? ranking.GetResultId(CountTrailingZeros(nUnit % 4)) : INSP_PASS };
+					nAccepted[nProducer] += sink.Push(nProducer, record);
+				}
+			});
+		}
+		for (auto itr = producers.begin(); itr != producers.end(); ++itr)
+			itr->join();
+		sink.Flush();
+		return nAccepted[0] + nAccepted[1];
+	};
+
+	atomic<size_t> nHandled(0);
+	string strLast;
+	CResultSink blockingSink(ranking, nProducers, 64, CResultSink::FP_Block, [&](const ResultRecord& record, const string& strDesc)
+	{
+		++nHandled;
+		if (record.m_nUnitId == 3)
+			strLast = strDesc;
+	});
+	const size_t nBlockingAccepted = run(blockingSink);
+	assert(nBlockingAccepted == nProducers * nUnitsPerProducer);
+	(void)nBlockingAccepted;
+	assert(nHandled == nProducers * nUnitsPerProducer);
+	assert(blockingSink.GetDropCount() == 0);
+	assert(strLast == "Unit 3: Ball Height, Warpage");
+
+	// with the consumer stopped, a blocking push is dropped instead of spinning forever
+	blockingSink.Stop();
+	ResultRecord lateRecord = { 0, 0, INSP_PASS };
+	const bool bLateAccepted = blockingSink.Push(0, lateRecord);
+	assert(!bLateAccepted);
+	(void)bLateAccepted;
+	assert(blockingSink.GetDropCount() == 1);
+
+	// a slow handler with tiny rings forces drops, but every record is either handled or counted
+	nHandled = 0;
+	CResultSink droppingSink(ranking, nProducers, 4, CResultSink::FP_Drop, [&](const ResultRecord&, const string&)
+	{
+		++nHandled;
+		this_thread::sleep_for(chrono::microseconds(10));
+	});
+	const size_t nAccepted = run(droppingSink);
+	assert(nHandled == nAccepted);
+	assert(nAccepted + droppingSink.GetDropCount() == nProducers * nUnitsPerProducer);
+
+	cout << "\nTestResultSink\n";
+	cout << left << setw(20) << "Handled" << ": " << nAccepted << ", dropped=" << droppingSink.GetDropCount() << endl;
+}
+
+void TestCalibration()
+{
+	CToleranceMinMaxT<double, TolPerPinTraits> tol1("Ball Height", "", -5.0, 5.0);
+	tol1.SetEnabled(true);
+
+	vector<CToleranceBase*> tolerances;
+	tolerances.push_back(&tol1);
+
+	CPriorityRanking ranking;
+	ranking.Freeze(tolerances, g_resultIds);
+
+	// head 1 reads 10% high with a 5 unit offset, pin 2 of head 1 is 2 units low on top of that
+	CorrectionFactor<double> head1 = { 1.0 / 1.1, -5.0 };
+	CorrectionFactor<double> head1Pin2 = { 1.0 / 1.1, -3.0 };
+	CCalibrationTable calibration;
+	calibration.SetHeadFactor(1, head1);
+	calibration.SetPinFactor(1, 2, head1Pin2);
+
+	const double nominals[] = { 100.0, 100.0, 100.0 };
+	const double heights[] =
+	{
+		101.0, 99.0, 104.0,		// head 0, uncorrected: pass
+		120.0, 115.5, 110.0,	// head 1: 104.09, 100, 97
+		115.5, 115.5, 110.0,	// head 1: 100, 100, 97: pass
+		106.0, 100.0, 100.0		// head 0: +6 fail
+	};
+	const int heads[] = { 0, 1, 1, 0 };
+
+	CStripEvaluator evaluator(ranking, 2);
+	evaluator.AddTolerance(&tol1, 3, nominals, &calibration);
+	evaluator.Freeze();
+
+	vector<const double*> measurements(1, heights);
+	evaluator.Evaluate(measurements, 4, heads);
+	assert(evaluator.IsUnitPass(0));
+	assert(evaluator.IsUnitPass(1));		// 120 / 1.1 - 5 = 104.09, +4.09 is within +5
+	assert(evaluator.IsUnitPass(2));
+	assert(!evaluator.IsUnitPass(3));
+
+	tol1.SetRejectUCL(4.0);
+	evaluator.Freeze();
+	evaluator.Evaluate(measurements, 4, heads);
+	assert(!evaluator.IsUnitPass(1));
+
+	// archived raw values re-evaluate to the same verdicts
+	CMeasurementArchive archive;
+	archive.AddTolerance(&tol1, 3, vector<double>(begin(nominals), end(nominals)), &calibration);
+	for (size_t nUnit = 0; nUnit < 4; ++nUnit)
+		archive.AddUnit(vector<const double*>(1, heights + nUnit * 3), heads[nUnit]);
+
+	CReevalCache cache(archive, ranking);
+	cache.Refresh();
+	for (size_t nUnit = 0; nUnit < 4; ++nUnit)
+		assert(cache.IsUnitPass(nUnit) == evaluator.IsUnitPass(nUnit));
+
+	CLimitSweep sweep(archive, cache, 0);
+	assert(sweep.GetPassCount(-5.0, 5.0) == 3);
+	assert(sweep.GetPassCount(-5.0, 4.0) == cache.GetPassCount());
+
+	// heads without factors get identity rows, unknown heads are rejected
+	const int unknownHeads[] = { 0, 1, 2, 0 };
+	bool bThrown = false;
+	try
+	{
+		evaluator.Evaluate(measurements, 4, unknownHeads);
+	}
+	catch (const out_of_range&)
+	{
+		bThrown = true;
+	}
+	assert(bThrown);
+
+	bThrown = false;
+	try
+	{
+		archive.AddUnit(vector<const double*>(1, heights), -1);
+	}
+	catch (const invalid_argument&)
+	{
+		bThrown = true;
+	}
+	assert(bThrown);
+	(void)bThrown;
+
+	archive.AddUnit(vector<const double*>(1, heights + 3), 2);		// head 2 is uncorrected: +20 fail
+	size_t nRecomputed = cache.Refresh();
+	assert(nRecomputed == 1);
+	(void)nRecomputed;
+	assert(!cache.IsUnitPass(4));
+
+	cout << "\nTestCalibration\n";
+	for (size_t nUnit = 0; nUnit < evaluator.GetUnitCount(); ++nUnit)
+		cout << left << setw(20) << "Unit " + to_string(nUnit) << ": head=" << heads[nUnit] << ", " << (evaluator.IsUnitPass(nUnit) ? "Pass" : "Fail") << endl;
+}
+
+void TestWarpageFit()
+{
+	CToleranceMaxT<double, Tol3DTraits> tol1("Warpage", "", 0.1);
+
+	// 20 x 20 grid over a 10mm package bowed by 0.05mm along x and tilted along y,
+	// with +-1um of sensor noise
+	vector<double> x, y, z;
+	for (int i = 0; i < 20; ++i)
+	{
+		for (int j = 0; j < 20; ++j)
+		{
+			x.push_back(i * 10.0 / 19);
+			y.push_back(j * 10.0 / 19);
+			z.push_back(0.002 * (x.back() - 5.0) * (x.back() - 5.0) + 0.001 * y.back() + ((i * 7 + j * 13) % 5 - 2) * 0.0005);
+		}
+	}
+
+	// debris on a few samples and one sensor dropout
+	z[7] += 0.5;
+	z[123] += 0.8;
+	z[250] -= 0.6;
+	z[391] += 0.4;
+	z[57] = numeric_limits<double>::quiet_NaN();
+
+	CWarpageFitter::Settings settings = { CWarpageFitter::WF_Plane, 20, chrono::microseconds(100000), 4.685, 1e-9, 0.02 };
+	CWarpageFitter planeFitter(settings);
+	double dPlaneWarpage = 0.0;
+	bool bFitted = planeFitter.Fit(x.data(), y.data(), z.data(), z.size(), dPlaneWarpage);
+	assert(bFitted);
+	assert(planeFitter.GetInlierCount() == z.size() - 5);
+	assert(fabs(dPlaneWarpage - 0.05) < 0.005);		// LS over all points would report over 1mm
+	assert(tol1.CheckTolerance(dPlaneWarpage));
+
+	settings.m_Model = CWarpageFitter::WF_Quadric;
+	CWarpageFitter quadricFitter(settings);
+	double dQuadricWarpage = 0.0;
+	bFitted = quadricFitter.Fit(x.data(), y.data(), z.data(), z.size(), dQuadricWarpage);
+	assert(bFitted);
+	assert(quadricFitter.IsConverged());
+	assert(fabs(quadricFitter.GetCoefficients()[3] - 0.002) < 1e-4);
+	assert(fabs(dQuadricWarpage - 0.05) < 0.002);
+
+	// the next unit starts from the previous solution
+	const size_t nColdIterations = quadricFitter.GetIterations();
+	double dWarmWarpage = 0.0;
+	bFitted = quadricFitter.Fit(x.data(), y.data(), z.data(), z.size(), dWarmWarpage);
+	assert(bFitted);
+	const size_t nWarmIterations = quadricFitter.GetIterations();
+	const size_t nPlaneInliers = planeFitter.GetInlierCount();
+	assert(nWarmIterations <= nColdIterations);
+
+	// a lifted corner is deformation, not debris: 16 of 400 samples rejected is too many
+	vector<double> lifted(x.size());
+	for (size_t i = 0; i < lifted.size(); ++i)
+		lifted[i] = (x[i] < 2.0 && y[i] < 2.0) ? 0.3 : 0.0;
+	CWarpageFitter liftFitter(settings);
+	double dLiftedWarpage = -1.0;
+	bFitted = liftFitter.Fit(x.data(), y.data(), lifted.data(), lifted.size(), dLiftedWarpage);
+	assert(!bFitted);
+	assert(liftFitter.GetInlierCount() == lifted.size() - 16);
+	assert(dLiftedWarpage == -1.0);
+
+	// degenerate units report no warpage instead of a passing 0, warm started or not
+	const double lineX[] = { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 };
+	const double lineY[] = { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 };
+	const double lineZ[] = { 0.0, 0.1, 0.0, 0.1, 0.0, 0.1, 0.0 };
+	double dDegenerate = -1.0;
+	bFitted = quadricFitter.Fit(lineX, lineY, lineZ, 7, dDegenerate);
+	assert(!bFitted);
+	bFitted = planeFitter.Fit(lineX, lineY, lineZ, 2, dDegenerate);
+	assert(!bFitted);
+	bFitted = planeFitter.Fit(lineX, lineY, lineZ, 7, dDegenerate);
+	assert(!bFitted);
+	(void)bFitted;
+	assert(dDegenerate == -1.0);
+
+	cout << "\nTestWarpageFit\n";
+	cout << left << setw(20) << "Plane" << ": " << setprecision(4) << dPlaneWarpage << ", inliers=" << nPlaneInliers << endl;
+	cout << left << setw(20) << "Quadric" << ": " << setprecision(4) << dQuadricWarpage << ", iterations=" << nColdIterations << "/" << nWarmIterations << endl;
+}
+
+void TestBallCheck()
+{
+	CToleranceMinMaxT<double, TolPerPinTraits> tol1("Ball Height", "", -5.0, 5.0);
+	tol1.SetEnabled(true);
+	tol1.SetPriority(0);
+
+	CToleranceMinMaxT<double, Tol2DPerPinTraits> tol2("Ball Pitch", "", 480.0, 520.0);
+	tol2.SetEnabled(true);
+	tol2.SetPriority(1);
+
+	CToleranceAbsMinT<double, Tol2DPerPinTraits> tol3("Ball Quality", "", 60.0);
+	tol3.SetEnabled(true);
+	tol3.SetPriority(2);
+
+	CToleranceAbsMinMaxT<double, Tol2DPerPinTraits> tol4("Pad Size", "", 200.0, 300.0);
+	tol4.SetPriority(3);		// disabled
+
+	CToleranceMaxT<double, Tol3DTraits> tol5("Warpage", "", 50.0);
+	tol5.SetPriority(4);
+
+	vector<CToleranceBase*> tolerances;
+	tolerances.push_back(&tol1);
+	tolerances.push_back(&tol2);
+	tolerances.push_back(&tol3);
+	tolerances.push_back(&tol4);
+	tolerances.push_back(&tol5);
+
+	CPriorityRanking ranking;
+	ranking.Freeze(tolerances, g_resultIds);
+
+	// 150 balls spanning three mask words
+	const size_t nPins = 150;
+	vector<double> heightNominals(nPins);
+	vector<BallRecord> balls(nPins);
+	for (size_t nPin = 0; nPin < nPins; ++nPin)
+	{
+		heightNominals[nPin] = 300.0 + (nPin % 3);
+		BallRecord ball = { heightNominals[nPin] + (nPin % 17) - 8.0, 500.0 + (nPin % 53) - 26.0, 50.0 + (nPin % 41), 100.0 };
+		balls[nPin] = ball;
+	}
+
+	CBallChecker checker(ranking, nPins);
+	checker.AddTolerance(&tol1, &BallRecord::m_dHeight, heightNominals.data());
+	checker.AddTolerance(&tol2, &BallRecord::m_dPitch);
+	checker.AddTolerance(&tol3, &BallRecord::m_dQuality);
+	checker.AddTolerance(&tol4, &BallRecord::m_dPadSize);
+	checker.Freeze();
+	checker.Evaluate(balls.data());
+
+	bool bThrown = false;
+	try
+	{
+		checker.AddTolerance(&tol5, &BallRecord::m_dHeight);
+	}
+	catch (const invalid_argument&)
+	{
+		bThrown = true;
+	}
+	assert(bThrown);
+
+	// every bit must agree with checking each tolerance on its own
+	auto is_set = [](const vector<unsigned long long>& bits, size_t nPin) { return (bits[nPin / 64] >> (nPin % 64) & 1) != 0; };
+	size_t nFailPins = 0;
+	for (size_t nPin = 0; nPin < nPins; ++nPin)
+	{
+		const bool bHeightFail = !tol1.CheckTolerance(balls[nPin].m_dHeight - heightNominals[nPin]);
+		const bool bPitchFail = !tol2.CheckTolerance(balls[nPin].m_dPitch);
+		const bool bQualityFail = !tol3.CheckTolerance(balls[nPin].m_dQuality);
+		assert(is_set(checker.GetFailBits(0), nPin) == bHeightFail);
+		assert(is_set(checker.GetFailBits(1), nPin) == bPitchFail);
+		assert(is_set(checker.GetFailBits(2), nPin) == bQualityFail);
+		assert(!is_set(checker.GetFailBits(3), nPin));
+		assert(checker.IsPinPass(nPin) == !(bHeightFail || bPitchFail || bQualityFail));
+		(void)bHeightFail;
+		(void)bPitchFail;
+		(void)bQualityFail;
+		nFailPins += !checker.IsPinPass(nPin);
+	}
+	(void)is_set;
+	assert(checker.GetFailRanks() == 7);
+
+	// only heads the checker was built for, and only after Freeze
+	bThrown = false;
+	try
+	{
+		checker.Evaluate(balls.data(), 1);
+	}
+	catch (const out_of_range&)
+	{
+		bThrown = true;
+	}
+	assert(bThrown);
+
+	CBallChecker unfrozen(ranking, nPins);
+	unfrozen.AddTolerance(&tol1, &BallRecord::m_dHeight, heightNominals.data());
+	bThrown = false;
+	try
+	{
+		unfrozen.Evaluate(balls.data());
+	}
+	catch (const logic_error&)
+	{
+		bThrown = true;
+	}
+	assert(bThrown);
+	(void)bThrown;
+
+	cout << "\nTestBallCheck\n";
+	cout << left << setw(20) << "Fail Pins" << ": " << nFailPins << " of " << nPins << endl;
+}
+
 int main()
 {
 	TestMinMax();
@@ -292,6 +952,13 @@ int main()
 	TestFailResult();
 	TestRejectType();
 	TestHasPerPin();
+	TestStripEvaluation();
+	TestReevaluation();
+	TestLimitSweep();
+	TestResultSink();
+	TestCalibration();
+	TestWarpageFit();
+	TestBallCheck();
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "tolerance.h"
+#include "result.h"
+#include "archive.h"
+#include "stripeval.h"
+#include "bitops.h"
+
+// Re-evaluation cache
+// Keeps one fail bit per unit and tolerance next to an archive, so changing the limits
+// or enable flag of one tolerance only recomputes that column. Unit verdicts and the
+// first failed rank are then recombined from the bitmaps 64 units at a time.
+class CReevalCache
+{
+public:
+	// units checked per call of the column kernel
+	static const size_t UnitBlock = 4096;
+
+	CReevalCache(const CMeasurementArchive& archive, const CPriorityRanking& ranking) :
+		m_Archive(archive),
+		m_Ranking(ranking),
+		m_nUnits(0)
+	{
+		m_Columns.resize(archive.GetColumnCount());
+		for (size_t nColumn = 0; nColumn < m_Columns.size(); ++nColumn)
+			m_Columns[nColumn].nRank = ranking.GetRank(archive.GetColumn(nColumn).pTol);
+
+		// columns by rank, so recombination visits them in priority order
+		for (size_t nColumn = 0; nColumn < m_Columns.size(); ++nColumn)
+			m_ByRank.emplace_back(nColumn);
+		std::sort(m_ByRank.begin(), m_ByRank.end(), [this](size_t nCol1, size_t nCol2)
+		{
+			return m_Columns[nCol1].nRank < m_Columns[nCol2].nRank;
+		});
+	}
+
+	// recompute the columns whose limits changed and recombine if any limit or enable
+	// flag changed since the last call; returns the number of recomputed columns
+	size_t Refresh()
+	{
+		// units appended to the archive invalidate every column
+		if (m_nUnits != m_Archive.GetUnitCount())
+		{
+			m_nUnits = m_Archive.GetUnitCount();
+			for (auto itr = m_Columns.begin(); itr != m_Columns.end(); ++itr)
+				itr->bValid = false;
+		}
+
+		size_t nRecomputed = 0;
+		bool bChanged = false;
+		for (size_t nColumn = 0; nColumn < m_Columns.size(); ++nColumn)
+		{
+			auto& column = m_Columns[nColumn];
+			const CToleranceBase* pTol = m_Archive.GetColumn(nColumn).pTol;
+
+			double dRejectLo, dRejectHi;
+			pTol->GetRejectLimits(dRejectLo, dRejectHi);
+			if (!column.bValid || dRejectLo != column.dRejectLo || dRejectHi != column.dRejectHi)
+			{
+				column.dRejectLo = dRejectLo;
+				column.dRejectHi = dRejectHi;
+				RecomputeColumn(nColumn);
+				column.bValid = true;
+				++nRecomputed;
+				bChanged = true;
+			}
+
+			if (pTol->IsEnabled() != column.bEnabled)
+			{
+				column.bEnabled = pTol->IsEnabled();
+				bChanged = true;
+			}
+		}
+
+		if (bChanged)
+			Recombine();
+		return nRecomputed;
+	}
+
+	// force a column to be recomputed by the next Refresh
+	void Invalidate(const CToleranceBase* pTol)
+	{
+		for (size_t nColumn = 0; nColumn < m_Columns.size(); ++nColumn)
+		{
+			if (m_Archive.GetColumn(nColumn).pTol == pTol)
+				m_Columns[nColumn].bValid = false;
+		}
+	}
+
+	// units covered by the last Refresh
+	size_t GetUnitCount() const
+	{
+		return m_nUnits;
+	}
+
+	// true when the fail bits of a column cover every archived unit at the current limits
+	bool IsCurrent(size_t nColumn) const
+	{
+		const auto& column = m_Columns[nColumn];
+		if (m_nUnits != m_Archive.GetUnitCount() || !column.bValid)
+			return false;
+
+		double dRejectLo, dRejectHi;
+		m_Archive.GetColumn(nColumn).pTol->GetRejectLimits(dRejectLo, dRejectHi);
+		return dRejectLo == column.dRejectLo && dRejectHi == column.dRejectHi;
+	}
+
+	bool IsUnitPass(size_t nUnit) const
+	{
+		CheckUnitCount();
+		return (m_UnitFail[nUnit / 64] >> (nUnit % 64) & 1) == 0;
+	}
+
+	INSP_RESULT_ID GetFirstFailResultId(size_t nUnit) const
+	{
+		if (IsUnitPass(nUnit))
+			return INSP_PASS;
+		return m_Ranking.GetResultId(m_FirstFailRanks[nUnit]);
+	}
+
+	size_t GetPassCount() const
+	{
+		CheckUnitCount();
+		size_t nFail = 0;
+		for (auto itr = m_UnitFail.begin(); itr != m_UnitFail.end(); ++itr)
+			nFail += PopCount(*itr);
+		return m_nUnits - nFail;
+	}
+
+	// per-unit fail bits of one column regardless of its enable flag
+	const std::vector<unsigned long long>& GetColumnFailBits(size_t nColumn) const
+	{
+		return m_Columns[nColumn].vFailBits;
+	}
+
+	// per-unit fail bits over all enabled columns
+	const std::vector<unsigned long long>& GetUnitFailBits() const
+	{
+		return m_UnitFail;
+	}
+
+private:
+	struct CacheColumn
+	{
+		CacheColumn() :
+			nRank(0), dRejectLo(0.0), dRejectHi(0.0), bEnabled(false), bValid(false)
+		{ }
+
+		size_t nRank;
+		double dRejectLo;
+		double dRejectHi;
+		bool bEnabled;
+		bool bValid;
+		std::vector<unsigned long long> vFailBits;		// one bit per unit
+	};
+
+	size_t GetWordCount() const
+	{
+		return (m_nUnits + 63) / 64;
+	}
+
+	// verdicts of units added since the last Refresh do not exist yet
+	void CheckUnitCount() const
+	{
+		if (m_nUnits != m_Archive.GetUnitCount())
+			throw std::logic_error("CReevalCache: archive has units the last Refresh did not cover");
+	}
+
+	void RecomputeColumn(size_t nColumn)
+	{
+		const auto& archived = m_Archive.GetColumn(nColumn);
+		auto& column = m_Columns[nColumn];
+		const size_t nUnits = m_nUnits;
+
+		std::vector<double> vMultipliers, vOffsets;
+		if (archived.pCalibration)
+			archived.pCalibration->Expand(m_Archive.GetHeadCount(), archived.nPins, archived.GetNominals(), vMultipliers, vOffsets);
+
+		column.vFailBits.assign(GetWordCount(), 0);
+		// local copy: std::min takes references and UnitBlock has no out-of-line definition
+		const size_t nBlock = UnitBlock;
+		m_UnitScratch.resize(nBlock);
+		for (size_t nUnitBegin = 0; nUnitBegin < nUnits; nUnitBegin += nBlock)
+		{
+			const size_t nCount = std::min(nBlock, nUnits - nUnitBegin);
+			std::fill(m_UnitScratch.begin(), m_UnitScratch.end(), static_cast<unsigned char>(0));
+			CheckStripColumn(archived.vValues.data() + nUnitBegin * archived.nPins, nCount, archived.nPins,
+				column.dRejectLo, column.dRejectHi, archived.GetNominals(), m_UnitScratch.data(),
+				m_Archive.GetHeads().data() + nUnitBegin,
+				vMultipliers.empty() ? nullptr : vMultipliers.data(), vOffsets.empty() ? nullptr : vOffsets.data());
+
+			// UnitBlock is a multiple of 64, so each block packs into whole words
+			for (size_t nUnit = 0; nUnit < nCount; ++nUnit)
+				column.vFailBits[(nUnitBegin + nUnit) / 64] |= static_cast<unsigned long long>(m_UnitScratch[nUnit]) << (nUnit % 64);
+		}
+	}
+
+	void Recombine()
+	{
+		const size_t nWords = GetWordCount();
+		m_UnitFail.assign(nWords, 0);
+		m_FirstFailRanks.resize(m_nUnits);
+
+		for (auto itr = m_ByRank.begin(); itr != m_ByRank.end(); ++itr)
+		{
+			const auto& column = m_Columns[*itr];
+			if (!column.bEnabled)
+				continue;
+
+			const unsigned char nRank = static_cast<unsigned char>(column.nRank);
+			for (size_t nWord = 0; nWord < nWords; ++nWord)
+			{
+				// units failing here for the first time take this rank as first fail
+				unsigned long long newFails = column.vFailBits[nWord] & ~m_UnitFail[nWord];
+				m_UnitFail[nWord] |= column.vFailBits[nWord];
+				for (; newFails != 0; newFails &= newFails - 1)
+					m_FirstFailRanks[nWord * 64 + CountTrailingZeros(newFails)] = nRank;
+			}
+		}
+	}
+
+	const CMeasurementArchive& m_Archive;
+	const CPriorityRanking& m_Ranking;
+
+	std::vector<CacheColumn> m_Columns;
+	std::vector<size_t> m_ByRank;
+
+	size_t m_nUnits;
+	std::vector<unsigned long long> m_UnitFail;			// one bit per unit
+	std::vector<unsigned char> m_FirstFailRanks;		// valid where the unit fail bit is set
+	std::vector<unsigned char> m_UnitScratch;
+};
\ No newline at end of file
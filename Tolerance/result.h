@@ -5,6 +5,10 @@
 #include <vector>
 #include <functional>
 #include <map>
+#include <tuple>
+#include <algorithm>
+#include <stdexcept>
+#include "bitops.h"
 
 struct CToleranceBase;
 
@@ -20,45 +24,118 @@ struct ResultFormat
 	ERejectType m_RejectType;
 };
 
+// Priority order of a frozen recipe. Tolerances are ranked once by priority, so
+// module results only need to record one bit per failed rank.
+class CPriorityRanking
+{
+public:
+	// one bit per ranked tolerance
+	static const size_t MaxTolerances = 64;
+
+	void Freeze(const std::vector<CToleranceBase*>& tolerances, const std::map<std::string, INSP_RESULT_ID>& resultIds)
+	{
+		if (tolerances.size() > MaxTolerances)
+			throw std::length_error("CPriorityRanking: too many tolerances");
+
+		m_Tolerances = tolerances;
+		std::stable_sort(m_Tolerances.begin(), m_Tolerances.end(), CToleranceBase::tolerance_by_priority);
+
+		m_Ranks.clear();
+		m_ResultIds.clear();
+		for (size_t nRank = 0; nRank < m_Tolerances.size(); ++nRank)
+		{
+			m_Ranks[m_Tolerances[nRank]] = nRank;
+			m_ResultIds.emplace_back(resultIds.at(m_Tolerances[nRank]->GetName()));
+		}
+	}
+
+	size_t GetCount() const
+	{
+		return m_Tolerances.size();
+	}
+
+	size_t GetRank(const CToleranceBase* pTol) const
+	{
+		return m_Ranks.at(pTol);
+	}
+
+	CToleranceBase* GetTolerance(size_t nRank) const
+	{
+		return m_Tolerances.at(nRank);
+	}
+
+	INSP_RESULT_ID GetResultId(size_t nRank) const
+	{
+		return m_ResultIds.at(nRank);
+	}
+
+private:
+	std::vector<CToleranceBase*> m_Tolerances;		// by rank
+	std::vector<INSP_RESULT_ID> m_ResultIds;		// by rank
+	std::map<const CToleranceBase*, size_t> m_Ranks;
+};
+
 class CModuleResult
 {
 public:
-	CModuleResult(const std::map<std::string, INSP_RESULT_ID>& resultIds) :
-		m_ResultIds(resultIds)
+	CModuleResult(const std::map<std::string, INSP_RESULT_ID>& resultIds, const CPriorityRanking& ranking) :
+		m_ResultIds(resultIds),
+		m_Ranking(ranking),
+		m_FailRanks(0),
+		m_ResultDescs(CPriorityRanking::MaxTolerances)		// the ranking may be (re)frozen after construction
 	{ }
 
 	void AddFailResult(CToleranceBase* pTol, std::string strResultDesc)
 	{
-		if (std::find(m_FailTolerances.begin(), m_FailTolerances.end(), pTol) != m_FailTolerances.end()) // already exists
+		AddFailResult(m_Ranking.GetRank(pTol), std::move(strResultDesc));
+	}
+
+	void AddFailResult(size_t nRank, std::string strResultDesc)
+	{
+		if (nRank >= CPriorityRanking::MaxTolerances)
+			throw std::out_of_range("CModuleResult: rank out of range");
+
+		const unsigned long long bit = 1ULL << nRank;
+		if (m_FailRanks & bit) // already exists
 			return;
 
-		m_FailTolerances.emplace_back(pTol);
-		m_ResultDescs.emplace(make_pair(pTol->GetName(), strResultDesc));
+		m_FailRanks |= bit;
+		m_ResultDescs[nRank] = std::move(strResultDesc);
+	}
+
+	// forget all failures so the same result can be reused for the next unit
+	void Clear()
+	{
+		m_FailRanks = 0;
+	}
+
+	bool IsPass() const
+	{
+		return m_FailRanks == 0;
+	}
+
+	// bit i set when the tolerance of rank i failed
+	unsigned long long GetFailRanks() const
+	{
+		return m_FailRanks;
 	}
 
 	// returns Result and Description of the first failed tolerance
-	std::tuple<std::string, INSP_RESULT_ID, std::string> GetFirstFailResult()
+	std::tuple<std::string, INSP_RESULT_ID, std::string> GetFirstFailResult() const
 	{
-		if (m_FailTolerances.empty())
+		if (m_FailRanks == 0)
 			return std::make_tuple("", INSP_PASS, "");
 
-		std::nth_element(m_FailTolerances.begin(), m_FailTolerances.begin(), m_FailTolerances.end(), CToleranceBase::tolerance_by_priority);
-		auto strName = m_FailTolerances.front()->GetName();
-		return std::make_tuple(strName, GetResultIdByTolName(strName), m_ResultDescs[strName]);
+		const size_t nRank = CountTrailingZeros(m_FailRanks);
+		return std::make_tuple(m_Ranking.GetTolerance(nRank)->GetName(), m_Ranking.GetResultId(nRank), m_ResultDescs[nRank]);
 	}
 
-	std::vector<int> GetFailResultIds()
+	// result ids of all failed tolerances, by priority
+	std::vector<int> GetFailResultIds() const
 	{
 		std::vector<int> vResultIds;
-		if (m_FailTolerances.empty())
-			return vResultIds;
-
-		using namespace std::placeholders;
-		std::sort(m_FailTolerances.begin(), m_FailTolerances.end(), CToleranceBase::tolerance_by_priority);
-		std::transform(m_FailTolerances.begin(), m_FailTolerances.end(), std::back_inserter(vResultIds), [&](const CToleranceBase* pTol)
-		{
-			return GetResultIdByTolName(pTol->GetName());
-		});
+		for (unsigned long long bits = m_FailRanks; bits != 0; bits &= bits - 1)
+			vResultIds.emplace_back(m_Ranking.GetResultId(CountTrailingZeros(bits)));
 		
 		return vResultIds;
 	}
@@ -76,15 +153,10 @@ public:
 	}
 
 private:
-	INSP_RESULT_ID GetResultIdByTolName(const std::string& strName) const
-	{
-		return m_ResultIds.at(strName);
-	}
-
 	const std::map<std::string, INSP_RESULT_ID>& m_ResultIds;
 	using ResultIdType = std::pair<std::string, INSP_RESULT_ID>;
 
-	std::vector<CToleranceBase*> m_FailTolerances;
-	//typedef decltype(CToleranceBase::GetName()) tol_name;
-	std::map<std::string, std::string> m_ResultDescs;
+	const CPriorityRanking& m_Ranking;
+	unsigned long long m_FailRanks;
+	std::vector<std::string> m_ResultDescs;		// by rank, valid where the fail bit is set
 };
\ No newline at end of file
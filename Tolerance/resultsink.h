@@ -0,0 +1,246 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include "result.h"
+#include "bitops.h"
+
+// compact verdict pushed by an inspection thread
+struct ResultRecord
+{
+	unsigned long long m_nUnitId;
+	unsigned long long m_nFailRanks;	// bit i set when the tolerance of rank i failed
+	INSP_RESULT_ID m_ResultId;			// first fail, INSP_PASS if none
+};
+
+// Bounded single-producer single-consumer ring; capacity is rounded up to a power of two
+template <typename T>
+class CSpscRing
+{
+public:
+	explicit CSpscRing(size_t nCapacity) :
+		m_nHead(0),
+		m_nTail(0)
+	{
+		size_t nSize = 1;
+		while (nSize < nCapacity)
+			nSize <<= 1;
+		m_Items.resize(nSize);
+		m_nMask = nSize - 1;
+	}
+
+	// producer side
+	bool TryPush(const T& item)
+	{
+		const size_t nTail = m_nTail.load(std::memory_order_relaxed);
+		if (nTail - m_nHead.load(std::memory_order_acquire) > m_nMask)
+			return false;
+
+		m_Items[nTail & m_nMask] = item;
+		m_nTail.store(nTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// records pushed so far; read by any thread
+	size_t GetPushCount() const
+	{
+		return m_nTail.load(std::memory_order_acquire);
+	}
+
+	// consumer side
+	bool TryPop(T& item)
+	{
+		const size_t nHead = m_nHead.load(std::memory_order_relaxed);
+		if (nHead == m_nTail.load(std::memory_order_acquire))
+			return false;
+
+		item = m_Items[nHead & m_nMask];
+		m_nHead.store(nHead + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::vector<T> m_Items;
+	size_t m_nMask;
+
+	// head and tail on separate cache lines so producer and consumer do not share one
+	char m_Pad0[64];
+	std::atomic<size_t> m_nHead;
+	char m_Pad1[64];
+	std::atomic<size_t> m_nTail;
+	char m_Pad2[64];
+};
+
+// Asynchronous result reporting
+// Each inspection thread owns one ring and only pays for a non-blocking push. A
+// background consumer formats every record and hands it to the handler, so logging
+// and host I/O never run on the inspection critical path.
+class CResultSink
+{
+public:
+	enum EFullPolicy
+	{
+		FP_Block = 1,		// spin until the consumer makes room, never loses a record
+		FP_Drop				// drop the new record and count it
+	};
+
+	using Handler = std::function<void(const ResultRecord&, const std::string&)>;
+
+	CResultSink(const CPriorityRanking& ranking, size_t nProducers, size_t nCapacity, EFullPolicy fullPolicy, Handler handler) :
+		m_Ranking(ranking),
+		m_FullPolicy(fullPolicy),
+		m_Handler(std::move(handler)),
+		m_nDropped(0),
+		m_nHandled(0),
+		m_bStop(false)
+	{
+		for (size_t nProducer = 0; nProducer < nProducers; ++nProducer)
+			m_Rings.emplace_back(new CSpscRing<ResultRecord>(nCapacity));
+		m_Consumer = std::thread(&CResultSink::Consume, this);
+	}
+
+	~CResultSink()
+	{
+		Stop();
+	}
+
+	// called only by the thread owning nProducer; returns false when the record was dropped.
+	// Once Stop has been called every push is dropped, so FP_Block never waits on a consumer
+	// that is gone. A push racing with Stop may return true and still be counted as dropped
+	// by Stop; producers must have returned from Push before Stop returns.
+	bool Push(size_t nProducer, const ResultRecord& record)
+	{
+		auto& ring = *m_Rings[nProducer];
+		for (;;)
+		{
+			if (m_bStop.load(std::memory_order_acquire))
+			{
+				m_nDropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			if (ring.TryPush(record))
+				return true;
+			if (m_FullPolicy == FP_Drop)
+			{
+				m_nDropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	// wait until every record pushed before the call has been handled
+	void Flush()
+	{
+		unsigned long long nTarget = 0;
+		for (auto itr = m_Rings.begin(); itr != m_Rings.end(); ++itr)
+			nTarget += (*itr)->GetPushCount();
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Handled.wait(lock, [&] { return m_nHandled >= nTarget || m_bStop; });
+	}
+
+	// drain what is queued and stop the consumer; later pushes are dropped
+	void Stop()
+	{
+		if (!m_Consumer.joinable())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_bStop = true;
+		}
+		m_Handled.notify_all();
+		m_Consumer.join();
+
+		// records pushed by producers that saw no stop request yet but landed after the
+		// consumer's last pass are never handled; count them so none goes missing silently
+		ResultRecord record;
+		for (auto itr = m_Rings.begin(); itr != m_Rings.end(); ++itr)
+		{
+			while ((*itr)->TryPop(record))
+				m_nDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		m_Handled.notify_all();
+	}
+
+	size_t GetDropCount() const
+	{
+		return m_nDropped.load(std::memory_order_relaxed);
+	}
+
+	// "Unit 7: Ball Height, Warpage" or "Unit 7: Pass"
+	std::string Format(const ResultRecord& record) const
+	{
+		std::string strDesc = "Unit " + std::to_string(record.m_nUnitId) + ": ";
+		if (record.m_nFailRanks == 0)
+			return strDesc + "Pass";
+
+		for (unsigned long long bits = record.m_nFailRanks; bits != 0; bits &= bits - 1)
+		{
+			strDesc += m_Ranking.GetTolerance(CountTrailingZeros(bits))->GetName();
+			if ((bits & (bits - 1)) != 0)
+				strDesc += ", ";
+		}
+		return strDesc;
+	}
+
+private:
+	void Consume()
+	{
+		bool bStopping = false;
+		for (;;)
+		{
+			size_t nCount = 0;
+			ResultRecord record;
+			for (auto itr = m_Rings.begin(); itr != m_Rings.end(); ++itr)
+			{
+				while ((*itr)->TryPop(record))
+				{
+					m_Handler(record, Format(record));
+					++nCount;
+				}
+			}
+
+			if (nCount != 0)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_Mutex);
+					m_nHandled += nCount;
+				}
+				m_Handled.notify_all();
+				continue;
+			}
+
+			// rings were empty after the stop request was seen, so everything is drained
+			if (bStopping)
+				return;
+
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			bStopping = m_bStop;
+			if (!bStopping)
+				m_Handled.wait_for(lock, std::chrono::milliseconds(1));
+		}
+	}
+
+	const CPriorityRanking& m_Ranking;
+	const EFullPolicy m_FullPolicy;
+	Handler m_Handler;
+
+	std::vector<std::unique_ptr<CSpscRing<ResultRecord>>> m_Rings;		// one per producer
+	std::atomic<size_t> m_nDropped;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Handled;
+	unsigned long long m_nHandled;
+	std::atomic<bool> m_bStop;			// written under m_Mutex, read lock-free by Push
+
+	std::thread m_Consumer;
+};
\ No newline at end of file
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "tolerance.h"
+#include "result.h"
+#include "defines.h"
+#include "correctionfactor.h"
+#include "bitops.h"
+
+// Strip evaluation
+// Measurements of a whole strip are passed per tolerance as a units x pins matrix
+// (row-major, one row per unit). Tolerances without per-pin values use a single column.
+//
+
+// Pins checked per tile, sized so the per-pin arrays stay in L1 while every unit of the
+// strip walks the same tile: 512 nominals are 4KB, and with calibration each head in use
+// reads a 4KB multiplier and a 4KB offset row, so a strip from a few heads still fits
+// a 32KB L1.
+static const size_t STRIP_PIN_TILE = 512;
+
+// Check one tolerance over a units x pins matrix and OR the failure of each unit into
+// pUnitFail. Relative values (value - nominal) are checked when pNominals is given.
+// With calibration, pMultipliers/pOffsets are heads x pins rows from
+// CCalibrationTable::Expand (nominals already folded in, pNominals is ignored) and
+// each unit uses the row of its head, 0 when pUnitHeads is null. Heads must index an
+// expanded row; callers validate them before calling.
+// Uses the same comparison as CheckTolerance, so NaN measurements pass.
+inline void CheckStripColumn(	const double* pValues, size_t nUnits, size_t nPins,
+								double dRejectLo, double dRejectHi,
+								const double* pNominals, unsigned char* pUnitFail,
+								const int* pUnitHeads = nullptr,
+								const double* pMultipliers = nullptr, const double* pOffsets = nullptr)
+{
+	for (size_t nPinBegin = 0; nPinBegin < nPins; nPinBegin += STRIP_PIN_TILE)
+	{
+		const size_t nPinEnd = std::min(nPins, nPinBegin + STRIP_PIN_TILE);
+		for (size_t nUnit = 0; nUnit < nUnits; ++nUnit)
+		{
+			const double* pRow = pValues + nUnit * nPins;
+			unsigned char bFail = 0;
+			if (pMultipliers)
+			{
+				// calibration is applied while checking, one multiply-add per pin
+				const size_t nHeadRow = (pUnitHeads ? static_cast<size_t>(pUnitHeads[nUnit]) : 0) * nPins;
+				const double* pMul = pMultipliers + nHeadRow;
+				const double* pOff = pOffsets + nHeadRow;
+				for (size_t nPin = nPinBegin; nPin < nPinEnd; ++nPin)
+				{
+					const double value = pRow[nPin] * pMul[nPin] + pOff[nPin];
+					bFail |= (value < dRejectLo) | (value > dRejectHi);
+				}
+			}
+			else if (pNominals)
+			{
+				for (size_t nPin = nPinBegin; nPin < nPinEnd; ++nPin)
+				{
+					const double value = pRow[nPin] - pNominals[nPin];
+					bFail |= (value < dRejectLo) | (value > dRejectHi);
+				}
+			}
+			else
+			{
+				for (size_t nPin = nPinBegin; nPin < nPinEnd; ++nPin)
+				{
+					const double value = pRow[nPin];
+					bFail |= (value < dRejectLo) | (value > dRejectHi);
+				}
+			}
+			pUnitFail[nUnit] |= bFail;
+		}
+	}
+}
+
+class CStripEvaluator
+{
+public:
+	// calibration tables are expanded for heads 0 .. nHeads - 1
+	CStripEvaluator(const CPriorityRanking& ranking, size_t nHeads = 1) :
+		m_Ranking(ranking),
+		m_nHeads(nHeads),
+		m_bFrozen(false),
+		m_bCalibrated(false),
+		m_nUnits(0)
+	{ }
+
+	// nPins is 1 for tolerances without per-pin values; the calibration table, if any,
+	// is expanded at Freeze and must outlive it
+	void AddTolerance(CToleranceBase* pTol, size_t nPins, const double* pNominals = nullptr, const CCalibrationTable* pCalibration = nullptr)
+	{
+		StripColumn column;
+		column.pTol = pTol;
+		column.nPins = nPins;
+		column.pNominals = pNominals;
+		column.pCalibration = pCalibration;
+		column.dRejectLo = 0.0;
+		column.dRejectHi = 0.0;
+		column.nRank = 0;
+		m_Columns.emplace_back(std::move(column));
+		m_bFrozen = false;
+	}
+
+	// snapshot limits of the enabled tolerances; call again whenever a limit or
+	// enable flag changes (priorities are fixed by the ranking)
+	void Freeze()
+	{
+		m_Enabled.clear();
+		m_bCalibrated = false;
+		for (size_t nColumn = 0; nColumn < m_Columns.size(); ++nColumn)
+		{
+			auto& column = m_Columns[nColumn];
+			if (!CToleranceBase::enabled_tolerance(column.pTol))
+				continue;
+
+			column.pTol->GetRejectLimits(column.dRejectLo, column.dRejectHi);
+			column.nRank = m_Ranking.GetRank(column.pTol);
+			if (column.pCalibration)
+			{
+				column.pCalibration->Expand(m_nHeads, column.nPins, column.pNominals, column.vMultipliers, column.vOffsets);
+				m_bCalibrated = true;
+			}
+			m_Enabled.emplace_back(nColumn);
+		}
+		m_bFrozen = true;
+	}
+
+	// vMeasurements[i] is the units x pins matrix of the i-th added tolerance;
+	// pUnitHeads selects the calibration row of each unit (head 0 when null)
+	void Evaluate(const std::vector<const double*>& vMeasurements, size_t nUnits, const int* pUnitHeads = nullptr)
+	{
+		if (!m_bFrozen)
+			throw std::logic_error("CStripEvaluator: Evaluate before Freeze");
+		if (vMeasurements.size() != m_Columns.size())
+			throw std::invalid_argument("CStripEvaluator: one measurement matrix per tolerance expected");
+
+		// heads only select calibration rows, so any head is fine without calibration
+		if (pUnitHeads && m_bCalibrated)
+		{
+			for (size_t nUnit = 0; nUnit < nUnits; ++nUnit)
+			{
+				if (pUnitHeads[nUnit] < 0 || static_cast<size_t>(pUnitHeads[nUnit]) >= m_nHeads)
+					throw std::out_of_range("CStripEvaluator: unit head out of range");
+			}
+		}
+
+		m_nUnits = nUnits;
+		m_FailMasks.assign(nUnits, 0);
+		m_UnitFail.resize(nUnits);
+
+		for (auto itr = m_Enabled.begin(); itr != m_Enabled.end(); ++itr)
+		{
+			const auto& column = m_Columns[*itr];
+			std::fill(m_UnitFail.begin(), m_UnitFail.end(), static_cast<unsigned char>(0));
+			CheckStripColumn(vMeasurements[*itr], nUnits, column.nPins,
+				column.dRejectLo, column.dRejectHi, column.pNominals, m_UnitFail.data(),
+				pUnitHeads, column.GetMultipliers(), column.GetOffsets());
+
+			// branch-free OR reduction over the strip; the first fail is the lowest set rank
+			const unsigned long long bit = 1ULL << column.nRank;
+			for (size_t nUnit = 0; nUnit < nUnits; ++nUnit)
+				m_FailMasks[nUnit] |= bit & (0ULL - m_UnitFail[nUnit]);
+		}
+	}
+
+	size_t GetUnitCount() const
+	{
+		return m_nUnits;
+	}
+
+	bool IsUnitPass(size_t nUnit) const
+	{
+		return m_FailMasks[nUnit] == 0;
+	}
+
+	// bit i set when the tolerance of priority rank i failed
+	unsigned long long GetFailMask(size_t nUnit) const
+	{
+		return m_FailMasks[nUnit];
+	}
+
+	INSP_RESULT_ID GetFirstFailResultId(size_t nUnit) const
+	{
+		if (m_FailMasks[nUnit] == 0)
+			return INSP_PASS;
+		return m_Ranking.GetResultId(CountTrailingZeros(m_FailMasks[nUnit]));
+	}
+
+	// refill a reusable module result with the failures of one unit,
+	// e.g. "Ball Height: (-5, 5), Fail" or "Warpage: > 50, Fail"
+	void FillModuleResult(size_t nUnit, CModuleResult& moduleResult) const
+	{
+		moduleResult.Clear();
+		for (auto itr = m_Enabled.begin(); itr != m_Enabled.end(); ++itr)
+		{
+			const auto& column = m_Columns[*itr];
+			if ((m_FailMasks[nUnit] >> column.nRank & 1) == 0)
+				continue;
+
+			std::ostringstream desc;
+			desc << column.pTol->GetName() << ": ";
+			if (column.dRejectLo == -std::numeric_limits<double>::infinity())
+				desc << "> " << column.dRejectHi;
+			else if (column.dRejectHi == std::numeric_limits<double>::infinity())
+				desc << "< " << column.dRejectLo;
+			else
+				desc << "(" << column.dRejectLo << ", " << column.dRejectHi << ")";
+			desc << ", Fail";
+			moduleResult.AddFailResult(column.nRank, desc.str());
+		}
+	}
+
+private:
+	struct StripColumn
+	{
+		CToleranceBase* pTol;
+		size_t nPins;
+		const double* pNominals;
+		const CCalibrationTable* pCalibration;
+		double dRejectLo;
+		double dRejectHi;
+		size_t nRank;
+		std::vector<double> vMultipliers;		// heads x pins, empty without calibration
+		std::vector<double> vOffsets;			// heads x pins, nominals folded in
+
+		const double* GetMultipliers() const
+		{
+			return vMultipliers.empty() ? nullptr : vMultipliers.data();
+		}
+
+		const double* GetOffsets() const
+		{
+			return vOffsets.empty() ? nullptr : vOffsets.data();
+		}
+	};
+
+	const CPriorityRanking& m_Ranking;
+	const size_t m_nHeads;
+
+	std::vector<StripColumn> m_Columns;
+	std::vector<size_t> m_Enabled;				// column indices of enabled tolerances
+	bool m_bFrozen;								// cleared by AddTolerance
+	bool m_bCalibrated;							// an enabled column has a calibration table
+
+	size_t m_nUnits;
+	std::vector<unsigned long long> m_FailMasks;
+	std::vector<unsigned char> m_UnitFail;		// scratch, one flag per unit
+};
\ No newline at end of file
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "tolerance.h"
+#include "archive.h"
+#include "reeval.h"
+
+struct SweepPoint
+{
+	double dRejectLo;
+	double dRejectHi;
+	size_t nPass;			// units passing every enabled tolerance
+	double dYield;			// nPass over all archived units
+	size_t nEscapes;		// pass at these limits, rejected by the reference limits
+	size_t nOverkills;		// rejected at these limits, pass at the reference limits
+};
+
+// Limit sweep over an archive for one tolerance
+// Each unit is reduced to its worst-case (min, max) value over all pins, so the unit
+// passes limits (lo, hi) exactly when min >= lo and max <= hi. Units failing any other
+// enabled tolerance (taken from a refreshed CReevalCache) are left out, since they
+// fail regardless of this tolerance. The limits of the tolerance when the sweep is
+// built are the reference for escapes and overkills.
+class CLimitSweep
+{
+public:
+	CLimitSweep(const CMeasurementArchive& archive, const CReevalCache& cache, size_t nColumn) :
+		m_nUnits(archive.GetUnitCount())
+	{
+		const auto& column = archive.GetColumn(nColumn);
+		column.pTol->GetRejectLimits(m_dRefLo, m_dRefHi);
+
+		std::vector<unsigned long long> otherFail((m_nUnits + 63) / 64, 0);
+		for (size_t nOther = 0; nOther < archive.GetColumnCount(); ++nOther)
+		{
+			if (nOther == nColumn || !archive.GetColumn(nOther).pTol->IsEnabled())
+				continue;
+
+			// the other tolerances' bits must cover every archived unit at their current limits
+			if (!cache.IsCurrent(nOther))
+				throw std::logic_error("CLimitSweep: re-evaluation cache is not refreshed for this archive");
+
+			const auto& failBits = cache.GetColumnFailBits(nOther);
+			for (size_t nWord = 0; nWord < otherFail.size(); ++nWord)
+				otherFail[nWord] |= failBits[nWord];
+		}
+
+		// values are value * multiplier + offset, nominal folded into the offset;
+		// an empty table gives identity rows for uncalibrated columns
+		std::vector<double> vMultipliers, vOffsets;
+		const CCalibrationTable uncalibrated;
+		const CCalibrationTable& calibration = column.pCalibration ? *column.pCalibration : uncalibrated;
+		calibration.Expand(archive.GetHeadCount(), column.nPins, column.GetNominals(), vMultipliers, vOffsets);
+
+		// worst case per unit; NaN never wins a comparison, matching CheckTolerance
+		const auto& heads = archive.GetHeads();
+		std::vector<WorstCase> units;
+		for (size_t nUnit = 0; nUnit < m_nUnits; ++nUnit)
+		{
+			if (otherFail[nUnit / 64] >> (nUnit % 64) & 1)
+				continue;
+
+			WorstCase worst = { std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() };
+			const double* pRow = column.vValues.data() + nUnit * column.nPins;
+			const size_t nHeadRow = static_cast<size_t>(heads[nUnit]) * column.nPins;
+			const double* pMul = vMultipliers.data() + nHeadRow;
+			const double* pOff = vOffsets.data() + nHeadRow;
+			for (size_t nPin = 0; nPin < column.nPins; ++nPin)
+			{
+				const double value = pRow[nPin] * pMul[nPin] + pOff[nPin];
+				worst.dMin = value < worst.dMin ? value : worst.dMin;
+				worst.dMax = value > worst.dMax ? value : worst.dMax;
+			}
+			units.emplace_back(worst);
+		}
+
+		m_ByMin = units;
+		std::sort(m_ByMin.begin(), m_ByMin.end(), [](const WorstCase& a, const WorstCase& b) { return a.dMin < b.dMin; });
+		m_ByMax = std::move(units);
+		std::sort(m_ByMax.begin(), m_ByMax.end(), [](const WorstCase& a, const WorstCase& b) { return a.dMax < b.dMax; });
+
+		BuildTree();
+		m_nRefPass = GetPassCount(m_dRefLo, m_dRefHi);
+	}
+
+	// units passing every enabled tolerance with this one at (lo, hi), O(log^2 n)
+	size_t GetPassCount(double dRejectLo, double dRejectHi) const
+	{
+		// pass = all - (min < lo) - (max > hi) + (min < lo and max > hi)
+		const size_t nBelow = std::lower_bound(m_ByMin.begin(), m_ByMin.end(), dRejectLo,
+			[](const WorstCase& unit, double dLimit) { return unit.dMin < dLimit; }) - m_ByMin.begin();
+		const size_t nAbove = m_ByMax.end() - std::upper_bound(m_ByMax.begin(), m_ByMax.end(), dRejectHi,
+			[](double dLimit, const WorstCase& unit) { return dLimit < unit.dMax; });
+		return m_ByMin.size() - nBelow - nAbove + CountAboveInPrefix(nBelow, dRejectHi);
+	}
+
+	double GetYield(double dRejectLo, double dRejectHi) const
+	{
+		return m_nUnits ? static_cast<double>(GetPassCount(dRejectLo, dRejectHi)) / m_nUnits : 0.0;
+	}
+
+	SweepPoint GetPoint(double dRejectLo, double dRejectHi) const
+	{
+		const size_t nPass = GetPassCount(dRejectLo, dRejectHi);
+		const size_t nBoth = GetPassCount(std::max(dRejectLo, m_dRefLo), std::min(dRejectHi, m_dRefHi));
+		return MakePoint(dRejectLo, dRejectHi, nPass, nBoth);
+	}
+
+	// yield curve over lower limit candidates with the upper limit fixed;
+	// candidates are sorted and walked in a single pass over the units
+	std::vector<SweepPoint> SweepRejectLo(std::vector<double> vCandidates, double dRejectHi) const
+	{
+		std::sort(vCandidates.begin(), vCandidates.end());
+
+		// units are visited by ascending min, counting those that also pass the upper limit
+		MinCursor pass(m_ByMin, dRejectHi);
+		MinCursor both(m_ByMin, std::min(dRejectHi, m_dRefHi));
+
+		std::vector<SweepPoint> vPoints;
+		for (auto itr = vCandidates.begin(); itr != vCandidates.end(); ++itr)
+		{
+			const size_t nPass = pass.CountFrom(*itr);
+			const size_t nBoth = both.CountFrom(std::max(*itr, m_dRefLo));
+			vPoints.emplace_back(MakePoint(*itr, dRejectHi, nPass, nBoth));
+		}
+		return vPoints;
+	}
+
+	// yield curve over upper limit candidates with the lower limit fixed
+	std::vector<SweepPoint> SweepRejectHi(double dRejectLo, std::vector<double> vCandidates) const
+	{
+		std::sort(vCandidates.begin(), vCandidates.end());
+
+		MaxCursor pass(m_ByMax, dRejectLo);
+		MaxCursor both(m_ByMax, std::max(dRejectLo, m_dRefLo));
+
+		std::vector<SweepPoint> vPoints;
+		for (auto itr = vCandidates.begin(); itr != vCandidates.end(); ++itr)
+		{
+			const size_t nPass = pass.CountUpTo(*itr);
+			const size_t nBoth = both.CountUpTo(std::min(*itr, m_dRefHi));
+			vPoints.emplace_back(MakePoint(dRejectLo, *itr, nPass, nBoth));
+		}
+		return vPoints;
+	}
+
+private:
+	struct WorstCase
+	{
+		double dMin;
+		double dMax;
+	};
+
+	// counts units with min >= lo and max <= hi for ascending lo
+	class MinCursor
+	{
+	public:
+		MinCursor(const std::vector<WorstCase>& byMin, double dRejectHi) :
+			m_ByMin(byMin), m_dRejectHi(dRejectHi), m_nPos(0), m_nSkipped(0), m_nTotal(0)
+		{
+			for (auto itr = byMin.begin(); itr != byMin.end(); ++itr)
+				m_nTotal += !(itr->dMax > dRejectHi);
+		}
+
+		size_t CountFrom(double dRejectLo)
+		{
+			for (; m_nPos < m_ByMin.size() && m_ByMin[m_nPos].dMin < dRejectLo; ++m_nPos)
+				m_nSkipped += !(m_ByMin[m_nPos].dMax > m_dRejectHi);
+			return m_nTotal - m_nSkipped;
+		}
+
+	private:
+		const std::vector<WorstCase>& m_ByMin;
+		double m_dRejectHi;
+		size_t m_nPos;
+		size_t m_nSkipped;
+		size_t m_nTotal;
+	};
+
+	// counts units with min >= lo and max <= hi for ascending hi
+	class MaxCursor
+	{
+	public:
+		MaxCursor(const std::vector<WorstCase>& byMax, double dRejectLo) :
+			m_ByMax(byMax), m_dRejectLo(dRejectLo), m_nPos(0), m_nCount(0)
+		{ }
+
+		size_t CountUpTo(double dRejectHi)
+		{
+			for (; m_nPos < m_ByMax.size() && !(m_ByMax[m_nPos].dMax > dRejectHi); ++m_nPos)
+				m_nCount += !(m_ByMax[m_nPos].dMin < m_dRejectLo);
+			return m_nCount;
+		}
+
+	private:
+		const std::vector<WorstCase>& m_ByMax;
+		double m_dRejectLo;
+		size_t m_nPos;
+		size_t m_nCount;
+	};
+
+	SweepPoint MakePoint(double dRejectLo, double dRejectHi, size_t nPass, size_t nBoth) const
+	{
+		SweepPoint point = { dRejectLo, dRejectHi, nPass,
+			m_nUnits ? static_cast<double>(nPass) / m_nUnits : 0.0,
+			nPass - nBoth, m_nRefPass - nBoth };
+		return point;
+	}
+
+	// Merge-sort tree over the min-sorted units holding their max values, one contiguous
+	// array of n values per level: level k (1 .. m_nLevels) is the max values sorted
+	// within aligned blocks of 2^k units. Level 0 is m_ByMin itself.
+	void BuildTree()
+	{
+		const size_t nUnits = m_ByMin.size();
+		m_nLevels = 0;
+		while ((size_t(1) << m_nLevels) < nUnits)
+			++m_nLevels;
+
+		m_Tree.resize(m_nLevels * nUnits);
+		for (size_t nLevel = 1; nLevel <= m_nLevels; ++nLevel)
+		{
+			const size_t nHalf = size_t(1) << (nLevel - 1);
+			double* pLevel = GetLevel(nLevel);
+			for (size_t nBegin = 0; nBegin < nUnits; nBegin += 2 * nHalf)
+			{
+				const size_t nMid = std::min(nUnits, nBegin + nHalf);
+				const size_t nEnd = std::min(nUnits, nBegin + 2 * nHalf);
+				if (nLevel == 1)
+				{
+					for (size_t i = nBegin; i < nEnd; ++i)
+						pLevel[i] = m_ByMin[i].dMax;
+					std::sort(pLevel + nBegin, pLevel + nEnd);
+				}
+				else
+				{
+					const double* pBelow = GetLevel(nLevel - 1);
+					std::merge(pBelow + nBegin, pBelow + nMid, pBelow + nMid, pBelow + nEnd, pLevel + nBegin);
+				}
+			}
+		}
+	}
+
+	double* GetLevel(size_t nLevel)
+	{
+		return m_Tree.data() + (nLevel - 1) * m_ByMin.size();
+	}
+
+	const double* GetLevel(size_t nLevel) const
+	{
+		return m_Tree.data() + (nLevel - 1) * m_ByMin.size();
+	}
+
+	// number of units among the first nPrefix by min whose max is above dRejectHi;
+	// the prefix splits into one aligned block per set bit of nPrefix
+	size_t CountAboveInPrefix(size_t nPrefix, double dRejectHi) const
+	{
+		size_t nCount = 0;
+		size_t nBegin = 0;
+		for (size_t nLevel = m_nLevels + 1; nLevel-- > 0; )
+		{
+			const size_t nSize = size_t(1) << nLevel;
+			if ((nPrefix & nSize) == 0)
+				continue;
+
+			if (nLevel == 0)
+				nCount += m_ByMin[nBegin].dMax > dRejectHi;
+			else
+			{
+				const double* pBlock = GetLevel(nLevel) + nBegin;
+				nCount += pBlock + nSize - std::upper_bound(pBlock, pBlock + nSize, dRejectHi);
+			}
+			nBegin += nSize;
+		}
+		return nCount;
+	}
+
+	size_t m_nUnits;
+	double m_dRefLo;
+	double m_dRefHi;
+	size_t m_nRefPass;
+
+	std::vector<WorstCase> m_ByMin;
+	std::vector<WorstCase> m_ByMax;
+
+	size_t m_nLevels;
+	std::vector<double> m_Tree;					// m_nLevels x units
+};
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <string>
 #include <map>
 #include <type_traits>
+#include <limits>
 #include "toltraits.h"
 #include "tolnominal.h"
 #include "defines.h"
@@ -71,6 +72,9 @@ struct CToleranceBase
 	
 	virtual bool HasRelativeMode() const = 0;
 
+	// reject limits widened to double; an unchecked side is reported as -/+infinity
+	virtual void GetRejectLimits(double& dRejectLo, double& dRejectHi) const = 0;
+
 private:
 	const std::string m_strName;
 	
@@ -110,6 +114,12 @@ public:
 	T GetRejectLCL() const { return m_dRejectLo; }
 	T GetRejectUCL() const { return m_dRejectHi; }
 
+	void GetRejectLimits(double& dRejectLo, double& dRejectHi) const
+	{
+		dRejectLo = static_cast<double>(m_dRejectLo);
+		dRejectHi = static_cast<double>(m_dRejectHi);
+	}
+
 protected:
 	T m_dRejectLo;
 	T m_dRejectHi;
@@ -135,6 +145,12 @@ public:
 	void SetRejectLCL(T value) { m_dRejectLo = value; }
 	T GetRejectLCL() const { return m_dRejectLo; }
 
+	void GetRejectLimits(double& dRejectLo, double& dRejectHi) const
+	{
+		dRejectLo = static_cast<double>(m_dRejectLo);
+		dRejectHi = std::numeric_limits<double>::infinity();
+	}
+
 private:
 	T m_dRejectLo;
 };
@@ -159,6 +175,12 @@ public:
 	void SetRejectUCL(T value) { m_dRejectHi = value; }
 	T GetRejectUCL() const { return m_dRejectHi; }
 
+	void GetRejectLimits(double& dRejectLo, double& dRejectHi) const
+	{
+		dRejectLo = -std::numeric_limits<double>::infinity();
+		dRejectHi = static_cast<double>(m_dRejectHi);
+	}
+
 private:
 	T m_dRejectHi;
 };
@@ -213,6 +235,11 @@ public:
 	{
 		return Traits::HasPerPin();
 	}
+
+	void GetRejectLimits(double& dRejectLo, double& dRejectHi) const override
+	{
+		TolCheck<T>::GetRejectLimits(dRejectLo, dRejectHi);
+	}
 };
 
 template <
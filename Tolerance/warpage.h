@@ -0,0 +1,334 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Robust warpage fitting
+// The package surface is fitted by iteratively reweighted least squares with Tukey
+// biweights, so a few bad height samples (debris, glare) get zero weight instead of
+// tilting the fit. Iterations stop at convergence, at m_nMaxIterations or when the time
+// budget is spent, whichever comes first, and each unit starts from the previous unit's
+// solution. The resulting warpage is checked by the Warpage tolerance (Tol3DTraits).
+// Non-finite samples (sensor dropouts) get zero weight and are never inliers.
+// Degenerate units (fewer points than terms, collinear points, no inliers) have no
+// warpage, and neither do units where the fit rejects more than m_dMaxOutlierFraction
+// of the samples, since that is real deformation rather than a few bad samples: Fit
+// returns false and the unit must be rejected rather than checked.
+//
+// Warpage is the peak-to-valley about the robust reference plane:
+// - WF_Plane: of the inlier heights about the fitted plane
+// - WF_Quadric: of the fitted quadric surface at the inlier points about its own
+//   best plane, so sample noise does not add to the warpage either
+//
+class CWarpageFitter
+{
+public:
+	enum EWarpageFit
+	{
+		WF_Plane = 1,		// z = c0 + c1 x + c2 y
+		WF_Quadric			// z = c0 + c1 x + c2 y + c3 x^2 + c4 xy + c5 y^2
+	};
+
+	struct Settings
+	{
+		EWarpageFit m_Model;
+		size_t m_nMaxIterations;
+		std::chrono::microseconds m_TimeBudget;
+		double m_dTuning;			// Tukey cut-off in robust sigmas, 4.685 for 95% efficiency
+		double m_dConvergence;		// stop when no coefficient moves more than this
+		double m_dMaxOutlierFraction;	// of the finite samples, e.g. 0.02
+	};
+
+	static const size_t MaxTerms = 6;
+	using Coefficients = std::array<double, MaxTerms>;
+
+	explicit CWarpageFitter(const Settings& settings) :
+		m_Settings(settings),
+		m_bWarmStart(false),
+		m_nFinite(0),
+		m_nIterations(0),
+		m_nInliers(0),
+		m_bConverged(false)
+	{
+		m_Coefficients.fill(0.0);
+	}
+
+	// forget the previous unit, e.g. on a package or recipe change
+	void ResetWarmStart()
+	{
+		m_bWarmStart = false;
+	}
+
+	// fit one unit given as separate x, y, z arrays; dWarpage is set only when true is returned
+	bool Fit(const double* pX, const double* pY, const double* pZ, size_t nPoints, double& dWarpage)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const size_t nTerms = GetTermCount();
+
+		m_nIterations = 0;
+		m_nInliers = 0;
+		m_bConverged = false;
+
+		// dropouts take no part in any solve
+		m_Weights.resize(nPoints);
+		m_nFinite = 0;
+		for (size_t i = 0; i < nPoints; ++i)
+		{
+			const bool bFinite = std::isfinite(pX[i]) && std::isfinite(pY[i]) && std::isfinite(pZ[i]);
+			m_Weights[i] = bFinite ? 1.0 : 0.0;
+			m_nFinite += bFinite;
+		}
+		if (m_nFinite < nTerms)
+			return false;
+
+		m_Residuals.resize(nPoints);
+
+		// cold start with ordinary least squares
+		if (!m_bWarmStart && !Solve(pX, pY, pZ, nPoints, m_Coefficients))
+			return false;
+		m_bWarmStart = true;
+
+		double dCutoff = UpdateWeights(pX, pY, pZ, nPoints);
+		while (m_nIterations < m_Settings.m_nMaxIterations &&
+			std::chrono::steady_clock::now() - start < m_Settings.m_TimeBudget)
+		{
+			// the weighted points no longer determine the surface
+			Coefficients next = m_Coefficients;
+			if (!Solve(pX, pY, pZ, nPoints, next))
+				return Reject();
+			++m_nIterations;
+
+			double dChange = 0.0;
+			for (size_t nTerm = 0; nTerm < nTerms; ++nTerm)
+				dChange = std::max(dChange, std::fabs(next[nTerm] - m_Coefficients[nTerm]));
+			m_Coefficients = next;
+			dCutoff = UpdateWeights(pX, pY, pZ, nPoints);
+
+			if (dChange < m_Settings.m_dConvergence)
+			{
+				m_bConverged = true;
+				break;
+			}
+		}
+
+		if (!MeasureWarpage(pX, pY, pZ, nPoints, dCutoff, dWarpage))
+			return Reject();
+		return true;
+	}
+
+	const Coefficients& GetCoefficients() const
+	{
+		return m_Coefficients;
+	}
+
+	size_t GetIterations() const
+	{
+		return m_nIterations;
+	}
+
+	size_t GetInlierCount() const
+	{
+		return m_nInliers;
+	}
+
+	// false when the iteration or time budget ran out first
+	bool IsConverged() const
+	{
+		return m_bConverged;
+	}
+
+private:
+	size_t GetTermCount() const
+	{
+		return m_Settings.m_Model == WF_Quadric ? 6 : 3;
+	}
+
+	// a failed unit must not seed the next one
+	bool Reject()
+	{
+		m_bWarmStart = false;
+		m_bConverged = false;
+		return false;
+	}
+
+	static void GetTerms(double x, double y, double* pTerms)
+	{
+		pTerms[0] = 1.0;
+		pTerms[1] = x;
+		pTerms[2] = y;
+		pTerms[3] = x * x;
+		pTerms[4] = x * y;
+		pTerms[5] = y * y;
+	}
+
+	// residuals z - f(x, y) in one branch-free pass over the arrays
+	void ComputeResiduals(const double* pX, const double* pY, const double* pZ, size_t nPoints,
+		const Coefficients& c, size_t nTerms, double* pResiduals) const
+	{
+		const double c3 = nTerms > 3 ? c[3] : 0.0;
+		const double c4 = nTerms > 3 ? c[4] : 0.0;
+		const double c5 = nTerms > 3 ? c[5] : 0.0;
+		for (size_t i = 0; i < nPoints; ++i)
+		{
+			const double x = pX[i];
+			const double y = pY[i];
+			pResiduals[i] = pZ[i] - (c[0] + c[1] * x + c[2] * y + c3 * x * x + c4 * x * y + c5 * y * y);
+		}
+	}
+
+	// Tukey biweights from the current residuals; returns the residual cut-off.
+	// Residuals of dropouts are NaN, so they get zero weight here as well.
+	double UpdateWeights(const double* pX, const double* pY, const double* pZ, size_t nPoints)
+	{
+		ComputeResiduals(pX, pY, pZ, nPoints, m_Coefficients, GetTermCount(), m_Residuals.data());
+
+		// robust sigma from the median absolute residual of the finite samples
+		m_Scratch.clear();
+		for (size_t i = 0; i < nPoints; ++i)
+		{
+			if (std::isfinite(m_Residuals[i]))
+				m_Scratch.emplace_back(std::fabs(m_Residuals[i]));
+		}
+		const size_t nMedian = m_Scratch.size() / 2;
+		std::nth_element(m_Scratch.begin(), m_Scratch.begin() + nMedian, m_Scratch.end());
+		const double dSigma = 1.4826 * m_Scratch[nMedian];
+		// floor for noise-free data, where the median residual is only rounding error
+		const double dCutoff = std::max(m_Settings.m_dTuning * dSigma, 1e-9);
+
+		const double dInvCutoff = 1.0 / dCutoff;
+		for (size_t i = 0; i < nPoints; ++i)
+		{
+			const double u = m_Residuals[i] * dInvCutoff;
+			const double t = 1.0 - u * u;
+			m_Weights[i] = t > 0.0 ? t * t : 0.0;
+		}
+		return dCutoff;
+	}
+
+	// weighted least squares through the normal equations
+	bool Solve(const double* pX, const double* pY, const double* pZ, size_t nPoints, Coefficients& c) const
+	{
+		return SolveWeighted(pX, pY, pZ, m_Weights.data(), nPoints, GetTermCount(), c);
+	}
+
+	static bool SolveWeighted(const double* pX, const double* pY, const double* pZ, const double* pWeights,
+		size_t nPoints, size_t nTerms, Coefficients& c)
+	{
+		double A[MaxTerms][MaxTerms + 1] = {};
+		double terms[MaxTerms];
+		for (size_t i = 0; i < nPoints; ++i)
+		{
+			const double w = pWeights[i];
+			if (w == 0.0)
+				continue;
+
+			GetTerms(pX[i], pY[i], terms);
+			for (size_t r = 0; r < nTerms; ++r)
+			{
+				const double wt = w * terms[r];
+				for (size_t k = r; k < nTerms; ++k)
+					A[r][k] += wt * terms[k];
+				A[r][nTerms] += wt * pZ[i];
+			}
+		}
+		for (size_t r = 1; r < nTerms; ++r)
+			for (size_t k = 0; k < r; ++k)
+				A[r][k] = A[k][r];
+
+		// Gaussian elimination with partial pivoting
+		for (size_t col = 0; col < nTerms; ++col)
+		{
+			size_t nPivot = col;
+			for (size_t r = col + 1; r < nTerms; ++r)
+				if (std::fabs(A[r][col]) > std::fabs(A[nPivot][col]))
+					nPivot = r;
+			if (std::fabs(A[nPivot][col]) < 1e-12)
+				return false;
+			if (nPivot != col)
+				for (size_t k = 0; k <= nTerms; ++k)
+					std::swap(A[col][k], A[nPivot][k]);
+
+			for (size_t r = col + 1; r < nTerms; ++r)
+			{
+				const double f = A[r][col] / A[col][col];
+				for (size_t k = col; k <= nTerms; ++k)
+					A[r][k] -= f * A[col][k];
+			}
+		}
+		for (size_t r = nTerms; r-- > 0; )
+		{
+			double sum = A[r][nTerms];
+			for (size_t k = r + 1; k < nTerms; ++k)
+				sum -= A[r][k] * c[k];
+			c[r] = sum / A[r][r];
+		}
+		for (size_t k = nTerms; k < MaxTerms; ++k)
+			c[k] = 0.0;
+		return true;
+	}
+
+	bool MeasureWarpage(const double* pX, const double* pY, const double* pZ, size_t nPoints, double dCutoff, double& dWarpage)
+	{
+		// inliers are the points inside the Tukey cut-off (a NaN residual never is)
+		m_Inliers.assign(nPoints, 0.0);
+		m_nInliers = 0;
+		for (size_t i = 0; i < nPoints; ++i)
+		{
+			const bool bInlier = std::fabs(m_Residuals[i]) <= dCutoff;
+			m_Inliers[i] = bInlier ? 1.0 : 0.0;
+			m_nInliers += bInlier;
+		}
+		if (m_nInliers == 0)
+			return false;
+
+		// too many rejected samples: the surface itself is deformed
+		const size_t nOutliers = m_nFinite - m_nInliers;
+		if (static_cast<double>(nOutliers) > m_Settings.m_dMaxOutlierFraction * m_nFinite)
+			return false;
+
+		// deviation of the inlier heights (plane) or of the fitted surface (quadric) from a plane
+		const double* pDeviation = m_Residuals.data();
+		if (m_Settings.m_Model == WF_Quadric)
+		{
+			m_Scratch.resize(nPoints);
+			for (size_t i = 0; i < nPoints; ++i)
+				m_Scratch[i] = pZ[i] - m_Residuals[i];
+
+			Coefficients plane;
+			if (!SolveWeighted(pX, pY, m_Scratch.data(), m_Inliers.data(), nPoints, 3, plane))
+				return false;
+			ComputeResiduals(pX, pY, m_Scratch.data(), nPoints, plane, 3, m_Scratch.data());
+			pDeviation = m_Scratch.data();
+		}
+
+		double dLow = 0.0, dHigh = 0.0;
+		bool bFirst = true;
+		for (size_t i = 0; i < nPoints; ++i)
+		{
+			if (m_Inliers[i] == 0.0)
+				continue;
+			dLow = bFirst ? pDeviation[i] : std::min(dLow, pDeviation[i]);
+			dHigh = bFirst ? pDeviation[i] : std::max(dHigh, pDeviation[i]);
+			bFirst = false;
+		}
+		dWarpage = dHigh - dLow;
+		return true;
+	}
+
+	const Settings m_Settings;
+
+	Coefficients m_Coefficients;		// previous unit's solution is the next warm start
+	bool m_bWarmStart;
+	size_t m_nFinite;					// samples with finite x, y and z
+	size_t m_nIterations;
+	size_t m_nInliers;
+	bool m_bConverged;
+
+	std::vector<double> m_Residuals;
+	std::vector<double> m_Weights;
+	std::vector<double> m_Inliers;		// 1.0 / 0.0, doubles as plane fit weights
+	std::vector<double> m_Scratch;
+};
\ No newline at end of file